@@ -172,6 +172,17 @@ classdef Saver < handle
         end
         
         
+        function fname = soloist_fname_prefix(obj)
+            % Get the start of the full path to the files of data collected on the Soloist controller.
+            % One file is written per gear command, numbered by :class:`rc.classes.Soloist`.
+            %
+            % :return: Full path to the Soloist data files, without the number and extension.
+        
+            fname_ = sprintf('%s_%s_%03i_soloist', obj.prefix, obj.suffix, obj.index);
+            fname = fullfile(obj.save_to, obj.prefix, fname_);
+        end
+        
+        
         function fname = cfg_fname(obj)
             % Get the full path to the configuration .cfg file.
             %
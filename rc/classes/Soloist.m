@@ -15,12 +15,20 @@ classdef Soloist < handle
         gear_scale % Value of GearCamScaleFactor to apply on the controller when in gear mode.
         deadband_limits = [0, 1]; % Limits of the :attr:`deadband` property.
         v_per_cm_per_s % Volts per cm/s (actually determined by Teensy) - NOTE AE confirm.
+        ramp_up_us = 200000 % Duration (us) of the ramp up of the gear scale factor.
+        ramp_down_us = 500000 % Duration (us) of the ramp down of the gear scale factor at the position limits.
+        ramp_shape = 'linear' % Shape of the ramps: 'linear', 'cosine', 's_curve' or 'table'.
+        ramp_table = [0, 1] % For a 'table' shape, the fraction of the ramp (0 to 1) at evenly spaced times.
+        collect_rate_hz = 0 % Rate (Hz) at which the controller samples the stage during gear commands. 0 for no data collection.
+        collect_prefix = '' % Start of the full path to the data collection files, set by :meth:`set_collect_prefix`. Empty for no data collection.
+        n_collected = 0 % Number of data collection files started with the current :attr:`collect_prefix`.
     end
     
     properties (SetAccess = private, Hidden = true)
         dir % Directory containing the executable files carrying out the Soloist commands.
         proc_array % :class:`rc.classes.ProcArray`
         h_abort % Handle to the process controlling rapid aborting of the currently executing Soloist command.
+        use_daemon % Boolean specifying whether commands are run by the daemon.exe process instead of separate executables.
         default_speed % Default speed to move the stage.
     end
     
@@ -52,6 +60,15 @@ classdef Soloist < handle
             obj.deadband = obj.deadband_scale * config.soloist.deadband;
             obj.v_per_cm_per_s = config.soloist.v_per_cm_per_s;
             
+            % ramps of the gear scale factor, set on the controller by each gear command
+            if isfield(config.soloist, 'ramp_up_us'), obj.ramp_up_us = config.soloist.ramp_up_us; end
+            if isfield(config.soloist, 'ramp_down_us'), obj.ramp_down_us = config.soloist.ramp_down_us; end
+            if isfield(config.soloist, 'ramp_shape'), obj.ramp_shape = config.soloist.ramp_shape; end
+            if isfield(config.soloist, 'ramp_table'), obj.ramp_table = config.soloist.ramp_table; end
+            
+            % data collection on the controller during gear commands
+            if isfield(config.soloist, 'collect_rate_hz'), obj.collect_rate_hz = config.soloist.collect_rate_hz; end
+            
             % we setup a separate process dedicated to aborting the current command
             % on the soloist... it runs constantly and is always connected to the
             % soloist (otherwise, connecting would take about 2s... to slow for an
@@ -59,8 +76,15 @@ classdef Soloist < handle
             % ideally all other commands to the soloist (home, listen_to, etc.) would 
             % also be immediate (and not run as separate executables... 
             % but that requires more sophisticated programming...)
-            abort_cmd = obj.full_command('abort');
-            obj.h_abort = SoloistAbortProc(abort_cmd);
+            % with `config.soloist.use_daemon` the daemon.exe process does this and
+            % also runs all other commands, so we don't connect for each of them.
+            obj.use_daemon = isfield(config.soloist, 'use_daemon') && config.soloist.use_daemon;
+            if obj.use_daemon
+                obj.h_abort = SoloistDaemonProc(obj.full_command('daemon'));
+            else
+                abort_cmd = obj.full_command('abort');
+                obj.h_abort = SoloistAbortProc(abort_cmd);
+            end
             
             % object for storing any processes created to interact with the
             % soloist... we can kill them all
@@ -124,6 +148,19 @@ classdef Soloist < handle
         end
         
         
+        function prepare(obj, cmd)
+            % Loads the programs of the next gear session while the current one is still running, so that it starts sooner.
+            % Only has an effect when commands are run by the daemon.exe process (`config.soloist.use_daemon`).
+            %
+            % :param cmd: Name of the next gear command: 'calibrate_zero', 'listen_until', 'mismatch_ramp_up_until' or 'mismatch_ramp_down_at'.
+        
+            if ~obj.enabled || ~obj.use_daemon, return, end
+            
+            str = obj.h_abort.send_signal(sprintf('prepare %s "%s"', cmd, obj.ab_dir));
+            fprintf('return message: %s\n', str);
+        end
+        
+        
         function proc = communicate(obj)
             % Communicates and resets the connection with the Soloist controller.
             %
@@ -150,15 +187,7 @@ classdef Soloist < handle
         
             if ~obj.enabled, return, end
             
-            cmd = obj.full_command('home');
-            disp(cmd)
-            
-            % start running the process
-            runtime = java.lang.Runtime.getRuntime();
-            p_java = runtime.exec(cmd);
-            
-            proc = ProcHandler(p_java);
-            obj.proc_array.add_process(proc);
+            obj.run_command('home');
             
             obj.homed = true;
         end
@@ -171,15 +200,7 @@ classdef Soloist < handle
         
             if ~obj.enabled, return, end
             
-            cmd = obj.full_command('reset');
-            disp(cmd)
-            
-            % start running the process
-            runtime = java.lang.Runtime.getRuntime();
-            p_java = runtime.exec(cmd);
-            
-            proc = ProcHandler(p_java);
-            obj.proc_array.add_process(proc);
+            obj.run_command('reset');
         end
         
         
@@ -228,15 +249,8 @@ classdef Soloist < handle
             % convert to logical
             end_enabled = logical(end_enabled);
             
-            fname = obj.full_command('move_to');
-            cmd = sprintf('%s %i %i %i', fname, pos, speed, end_enabled);
-            disp(cmd)
-            
-            % start running the process
-            runtime = java.lang.Runtime.getRuntime();
-            p_java = runtime.exec(cmd);
-            proc = ProcHandler(p_java);
-            obj.proc_array.add_process(proc);
+            args = sprintf('%i %i %i', pos, speed, end_enabled);
+            proc = obj.run_command('move_to', args);
         end
         
         
@@ -302,8 +316,30 @@ classdef Soloist < handle
                 return
             end
             
+            args = sprintf('%i %i %.8f %i "%s"', back_pos, forward_pos, offset, leave_enabled, obj.ab_dir);
+            
+            if obj.use_daemon
+                % the daemon reports the result when the operation is done
+                job = obj.run_command('calibrate_zero', args);
+                if isempty(job), return, end
+                
+                % give it 60s to complete
+                tic;
+                while job.isAlive()
+                    if toc > 60
+                        fprintf('no return signal from calibrate_zero\n');
+                        return
+                    end
+                    pause(0.01);
+                end
+                
+                % return value is in V, convert to mV
+                average_offset_mV = job.result()*1e3;
+                return
+            end
+            
             fname = obj.full_command('calibrate_zero');
-            cmd = sprintf('%s %i %i %.8f %i', fname, back_pos, forward_pos, offset, leave_enabled);
+            cmd = sprintf('%s %s', fname, args);
             
             disp(cmd)
             
@@ -383,17 +419,8 @@ classdef Soloist < handle
                 return
             end
             
-            obj.write_abi_header();
-            
-            fname = obj.full_command('listen_until');
-            cmd = sprintf('%s %i %i %.8f %.8f %i "%s"', fname, back_pos, forward_pos, obj.ai_offset, obj.deadband, wait_for_trigger, obj.ab_dir);
-            disp(cmd)
-            
-            % start running the process
-            runtime = java.lang.Runtime.getRuntime();
-            p_java = runtime.exec(cmd);
-            proc = ProcHandler(p_java);
-            obj.proc_array.add_process(proc);
+            args = sprintf('%i %i %.8f %.8f %.8f %i "%s" %s', back_pos, forward_pos, obj.ai_offset, obj.gear_scale, obj.deadband, wait_for_trigger, obj.ab_dir, [obj.ramp_args(), obj.collect_args()]);
+            proc = obj.run_command('listen_until', args);
         end
         
         
@@ -440,17 +467,8 @@ classdef Soloist < handle
                 return
             end
             
-            obj.write_abi_header();
-            
-            fname = obj.full_command('mismatch_ramp_down_at');
-            cmd = sprintf('%s %i %i %.8f %.8f %.8f "%s"', fname, back_pos, forward_pos, obj.ai_offset, obj.gear_scale, obj.deadband, obj.ab_dir);
-            disp(cmd)
-            
-            % start running the process
-            runtime = java.lang.Runtime.getRuntime();
-            p_java = runtime.exec(cmd);
-            proc = ProcHandler(p_java);
-            obj.proc_array.add_process(proc);
+            args = sprintf('%i %i %.8f %.8f %.8f "%s" %s', back_pos, forward_pos, obj.ai_offset, obj.gear_scale, obj.deadband, obj.ab_dir, [obj.ramp_args(), obj.collect_args()]);
+            proc = obj.run_command('mismatch_ramp_down_at', args);
         end
         
         
@@ -499,17 +517,8 @@ classdef Soloist < handle
                 return
             end
             
-            obj.write_abi_header();
-            
-            fname = obj.full_command('mismatch_ramp_up_until');
-            cmd = sprintf('%s %i %i %.8f %.8f %.8f "%s"', fname, back_pos, forward_pos, obj.ai_offset, obj.gear_scale, obj.deadband, obj.ab_dir);
-            disp(cmd)
-            
-            % start running the process
-            runtime = java.lang.Runtime.getRuntime();
-            p_java = runtime.exec(cmd);
-            proc = ProcHandler(p_java);
-            obj.proc_array.add_process(proc);
+            args = sprintf('%i %i %.8f %.8f %.8f "%s" %s', back_pos, forward_pos, obj.ai_offset, obj.gear_scale, obj.deadband, obj.ab_dir, [obj.ramp_args(), obj.collect_args()]);
+            proc = obj.run_command('mismatch_ramp_up_until', args);
         end
         
         
@@ -577,33 +586,74 @@ classdef Soloist < handle
         
         
         
-        function write_abi_header(obj)
-        %%write_abi_header Write Soloist parameters to a header file
-        %
-        %   write_abi_header() writes the parameters in `gear_scale` to a
-        %   header file for the .ab scripts to read and use when setting
-        %   the GearCamScaleFactor.
+        function set_collect_prefix(obj, prefix)
+            % Set the :attr:`collect_prefix` property. While it is set (and :attr:`collect_rate_hz` is not 0) each gear command
+            % collects data on the controller into the file <prefix>_<n>.bin, with n counting from 1.
+            %
+            % :param prefix: Start of the full path to the files, e.g. from :meth:`rc.classes.Saver.soloist_fname_prefix`. Empty to stop collecting.
         
-            % header file
-            header_fname = fullfile(obj.ab_dir, 'rc_shared_header.abi');
-            
-            str = {'HEADER', ...
-                   'DEFINE ramp_up_over_us 200000', ...
-                   'DEFINE ramp_down_over_us 500000', ...
-                   sprintf('DEFINE gear_scale %.2f', obj.gear_scale), ...
-                   'END HEADER'};
-            
-            file_text = strjoin(str, '\n');
-            
-            fid = fopen(header_fname, 'w');
-            fprintf(fid, '%s', file_text);
-            fclose(fid);
+            obj.collect_prefix = prefix;
+            obj.n_collected = 0;
         end
     end
     
     
     
     methods (Access = private)
+        function str = ramp_args(obj)
+            % Ramp arguments for the gear commands: durations of the ramps up and down (us), shape and the table for a 'table' shape.
+            %
+            % :return: String with the arguments.
+        
+            str = sprintf('%i %i %s', round(obj.ramp_up_us), round(obj.ramp_down_us), obj.ramp_shape);
+            if strcmp(obj.ramp_shape, 'table')
+                str = [str, sprintf(' %.6f', obj.ramp_table)];
+            end
+        end
+        
+        
+        
+        function str = collect_args(obj)
+            % Data collection arguments for the gear commands, with the name of the next file.
+            %
+            % :return: String with the arguments, empty if data are not collected.
+        
+            str = '';
+            if obj.collect_rate_hz <= 0 || isempty(obj.collect_prefix), return, end
+            
+            obj.n_collected = obj.n_collected + 1;
+            str = sprintf(' --collect "%s_%03i.bin" %i', obj.collect_prefix, obj.n_collected, round(obj.collect_rate_hz));
+        end
+        
+        
+        
+        function proc = run_command(obj, cmd, args)
+            % Runs a Soloist command, either on the daemon.exe process or as a separate executable.
+            %
+            % :param cmd: Command string, the name of the executable.
+            % :param args: String with the arguments to the command.
+            % :return: :class:`rc.classes.ProcHandler` or :class:`rc.classes.SoloistDaemonJob` object, handle to the running command.
+            
+            VariableDefault('args', '');
+            
+            if obj.use_daemon
+                fprintf('daemon: %s %s\n', cmd, args);
+                proc = obj.h_abort.start(cmd, args);
+            else
+                full_cmd = strtrim(sprintf('%s %s', obj.full_command(cmd), args));
+                disp(full_cmd)
+                
+                % start running the process
+                runtime = java.lang.Runtime.getRuntime();
+                p_java = runtime.exec(full_cmd);
+                proc = ProcHandler(p_java);
+            end
+            
+            obj.proc_array.add_process(proc);
+        end
+        
+        
+        
         function fname = full_command(obj, cmd)
             % Creates a full path from a command string.
             %
@@ -0,0 +1,73 @@
+classdef SoloistDaemonJob < handle
+    % SoloistDaemonJob class for an operation running on the daemon.exe process.
+    % Has the same interface as :class:`rc.classes.ProcHandler` so it can be stored in :class:`rc.classes.ProcArray`.
+
+    properties (SetAccess = private)
+        daemon % :class:`rc.classes.SoloistDaemonProc` running the operation.
+        op % Name of the operation.
+        id % Index of the operation on the daemon.
+    end
+
+
+
+    methods
+
+        function obj = SoloistDaemonJob(daemon, op, id)
+            % Constructor for a :class:`rc.classes.SoloistDaemonJob` class.
+            %
+            % :param daemon: The :class:`rc.classes.SoloistDaemonProc` running the operation.
+            % :param op: Name of the operation.
+            % :param id: Index of the operation on the daemon.
+
+            obj.daemon = daemon;
+            obj.op = op;
+            obj.id = id;
+        end
+
+
+
+        function running = isAlive(obj)
+            % Whether the operation is still running.
+            %
+            % :return: Boolean, true if the operation has not finished.
+
+            running = obj.daemon.is_running(obj.id);
+        end
+
+
+
+        function wait_for(obj, timeout)
+            % Wait for the operation to complete. Poll with a particular interval to allow MATLAB to run other processes.
+            %
+            % :param timeout: The poll interval in seconds.
+
+            while obj.isAlive()
+                pause(timeout)
+            end
+        end
+
+
+
+        function val = result(obj)
+            % Result reported by the daemon for the operation.
+            %
+            % :return: Mean analog input (V) for calibrate_zero, exit status for the gear operations. NaN if the operation is still running.
+
+            if obj.isAlive() || obj.daemon.n_done ~= obj.id
+                val = nan;
+                return
+            end
+            val = obj.daemon.last_result;
+        end
+
+
+
+        function kill(obj)
+            % Stop the operation if it is still running. Unlike :class:`rc.classes.ProcHandler` the daemon process stays alive, and the stage is disabled.
+
+            if obj.isAlive()
+                obj.daemon.run('stop');
+            end
+        end
+    end
+end
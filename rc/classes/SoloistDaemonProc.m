@@ -0,0 +1,232 @@
+classdef SoloistDaemonProc < handle
+    % SoloistDaemonProc class for controlling a separate process which stays
+    % connected to the soloist and runs all soloist commands (home, move_to,
+    % listen_until, etc.) as well as aborting and resetting motion.
+
+    properties (SetAccess = private)
+        cmd % Full filename of the daemon.exe executable.
+        proc % Handle to the java.lang.Runtime.exec process object.
+        writer % Stream to the standard output of the process.
+        reader % Stream to the standard input of the process.
+        n_started = 0 % Number of operations started on the daemon.
+        n_done = 0 % Number of operations the daemon has reported as finished.
+        last_result = nan % Result reported by the last finished operation.
+        last_telemetry = [] % Timing of the last gear operation, as reported by the daemon (see the Soloist usage guide).
+    end
+
+    properties (SetAccess = private, Hidden = true)
+        buffer = '' % Characters read from the process which do not yet make a full line.
+        replies = {} % Reply lines read from the process but not yet returned.
+        reply_words = {'started', 'busy', 'idle', 'error', 'prepared', 'aborted', 'stopped', 'pso_reset', 'shutdown'} % Words starting the reply lines of the process.
+    end
+
+    properties (Constant = true)
+        REPLY_TIMEOUT = 5 % Time to wait for the reply to a signal (s).
+        ABORT_TIMEOUT = 15 % Time to wait for the reply to 'abort', 'stop' and 'close' (s), longer than ABORT_JOIN_MS in daemon.cpp plus disabling and resetting the stage.
+        BUSY_TIMEOUT = 10 % Time to wait for a running operation to finish before another one is started (s).
+    end
+
+
+
+    methods
+        function obj = SoloistDaemonProc(cmd)
+            % Constructor for a :class:`rc.classes.SoloistDaemonProc` device.
+            % Controls a separate process which stays connected to the soloist and runs soloist commands.
+            %
+            % :param cmd: The full filename of the daemon.exe executable.
+
+            % open up the daemon.exe process... i.e. connect to soloist and
+            % wait for input on standard input.
+            obj.cmd = cmd;
+            runtime = java.lang.Runtime.getRuntime();
+            obj.proc = runtime.exec(obj.cmd);
+
+            % open up pipes to the process
+            obj.writer = obj.proc.getOutputStream();
+            obj.reader = obj.proc.getInputStream();
+        end
+
+
+        function delete(obj)
+            % Destructor for :class:`rc.classes.SoloistDaemonProc` device.
+
+            % upon deletion.
+            obj.close()
+        end
+
+
+        function run(obj, sig)
+            % Runs one of the abort functions in the daemon.exe process.
+            %
+            % :param sig: String specifying the function signal: 'abort', 'stop', 'reset_pso', 'close'.
+
+            VariableDefault('sig', 'stop');
+            str = obj.send_signal(sig, obj.ABORT_TIMEOUT);
+            fprintf('return message: %s\n', str);
+        end
+
+
+        function job = start(obj, op, args)
+            % Starts an operation on the daemon.exe process.
+            %
+            % :param op: Name of the operation, as the name of the executable: e.g. 'home', 'listen_until'.
+            % :param args: String with the arguments of the operation, as for the executable.
+            % :return: :class:`rc.classes.SoloistDaemonJob` object, handle to the operation. An error is raised if the operation could not be started.
+
+            VariableDefault('args', '');
+
+            sig = strtrim(sprintf('%s %s', op, args));
+            str = obj.send_signal(sig);
+
+            % The last operation may still be finishing, e.g. a move_to straight after the
+            % end of a listen_until, so wait for it rather than fail.
+            t = tic;
+            while strncmp(str, 'busy', 4) && toc(t) < obj.BUSY_TIMEOUT
+                pause(0.05);
+                str = obj.send_signal(sig);
+            end
+
+            if ~strncmp(str, 'started', 7)
+                error('%s: %s could not be started (%s)', class(obj), op, str);
+            end
+
+            obj.n_started = obj.n_started + 1;
+            job = SoloistDaemonJob(obj, op, obj.n_started);
+        end
+
+
+        function running = is_running(obj, id)
+            % Whether an operation started on the daemon is still running.
+            %
+            % :param id: Index of the operation, as stored in :class:`rc.classes.SoloistDaemonJob`.
+            % :return: Boolean, true if the daemon has not yet reported the operation as finished.
+
+            if ~obj.proc.isAlive()
+                running = false;
+                return
+            end
+
+            obj.read_lines();
+            running = obj.n_done < id;
+        end
+
+
+        function close(obj)
+            % Close the daemon.exe process. Send the 'close' signal to gracefully disconnect and also destroy the process if it still exists.
+
+            if obj.proc.isAlive()
+                obj.send_signal('close', obj.ABORT_TIMEOUT);
+            end
+            obj.proc.destroy();
+        end
+
+
+        function str = send_signal(obj, sig, timeout)
+            % Sends a signal to the daemon.exe process and waits for its reply.
+            %
+            % :param sig: String with the command line to send: e.g. 'abort', 'stop', 'status', 'home'.
+            % :param timeout: Optional time to wait for the reply (s), default :attr:`REPLY_TIMEOUT`.
+            % :return: The reply line from the process, or an empty string if none is received.
+
+            VariableDefault('timeout', obj.REPLY_TIMEOUT);
+            str = '';
+
+            % determine if process is still alive.
+            if ~obj.proc.isAlive()
+                fprintf('daemon process is not alive...restarting\n');
+                obj.restart();
+                return
+            end
+
+            % drop any replies left over from earlier signals
+            obj.read_lines();
+            obj.replies = {};
+
+            obj.writer.write(double(sprintf('%s\n', sig)));
+            obj.writer.flush()
+
+            t = tic;
+            while isempty(obj.replies)
+                if toc(t) > timeout
+                    fprintf('no return signal, %s, from daemon.exe\n', sig);
+                    return
+                end
+                obj.read_lines();
+            end
+
+            str = obj.replies{1};
+            obj.replies(1) = [];
+        end
+
+
+        function restart(obj)
+            % Restarts the daemon.exe process. Does nothing if the process is already alive.
+
+            if obj.proc.isAlive()
+                fprintf('daemon.exe is already running.\n')
+                return
+            end
+
+            % confirm that the restart is taking place
+            fprintf('restarting daemon.exe...')
+
+            % re-open up the daemon.exe process... i.e. connect to soloist and
+            % wait for input on standard input.
+            runtime = java.lang.Runtime.getRuntime();
+            obj.proc = runtime.exec(obj.cmd);
+
+            % open up pipes to the process
+            obj.writer = obj.proc.getOutputStream();
+            obj.reader = obj.proc.getInputStream();
+
+            % operations on the old process will never finish
+            obj.n_done = obj.n_started;
+            obj.buffer = '';
+            obj.replies = {};
+
+            if obj.proc.isAlive()
+                fprintf('restarted.\n')
+            else
+                fprintf('could not restart?\n')
+            end
+        end
+    end
+
+
+
+    methods (Access = private)
+        function read_lines(obj)
+            % Reads any available output of the process. 'done' lines are counted, reply lines are stored, 'telemetry' lines are decoded and anything else is printed.
+
+            n = obj.reader.available();
+            if n == 0, return, end
+
+            d = zeros(1, n);
+            for i = 1 : n
+                d(i) = obj.reader.read();
+            end
+            obj.buffer = [obj.buffer, char(d)];
+
+            idx = find(obj.buffer == newline, 1);
+            while ~isempty(idx)
+                line = strtrim(obj.buffer(1:idx-1));
+                obj.buffer = obj.buffer(idx+1:end);
+
+                if strncmp(line, 'done', 4)
+                    words = strsplit(line);
+                    obj.n_done = obj.n_done + 1;
+                    obj.last_result = str2double(words{end});
+                elseif strncmp(line, 'telemetry ', 10)
+                    obj.last_telemetry = jsondecode(line(11:end));
+                elseif any(strncmp(line, obj.reply_words, 4))
+                    obj.replies{end+1} = line;
+                elseif ~isempty(line)
+                    % progress messages printed by the operations
+                    fprintf('daemon: %s\n', line);
+                end
+
+                idx = find(obj.buffer == newline, 1);
+            end
+        end
+    end
+end
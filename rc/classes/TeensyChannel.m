@@ -0,0 +1,235 @@
+classdef TeensyChannel < handle
+    % TeensyChannel class for sending binary commands to the Teensy over USB serial.
+    %
+    % The Teensy script must be compiled with COMMAND_CHANNEL set (see the
+    % Teensy options). Each command is sent as a 17 byte packet and waits for
+    % its 16 byte acknowledgement, which the Teensy sends once the command is
+    % applied. A command which is not acknowledged within :attr:`timeout`
+    % seconds (e.g. because a byte was lost and the Teensy dropped the packet)
+    % is sent again with the same sequence number, up to :attr:`n_attempts`
+    % times. The Teensy does not apply a resent command twice.
+
+    properties
+        enabled % Boolean specifying whether the module is used.
+        port % Name of the serial port of the Teensy, e.g. 'COM3'.
+        timeout % Time to wait for each acknowledgement (s).
+        n_attempts % Number of times a command is sent before giving up.
+    end
+
+    properties (SetAccess = private)
+        sequence % Sequence number of the last command sent.
+        last_time_us % Teensy time at which the last command was applied (us).
+    end
+
+    properties (SetAccess = private, Hidden = true)
+        serial % Handle to the serialport object.
+        last_tic % Host time at which the last acknowledgement was received.
+    end
+
+    properties (Constant = true)
+        CMD_PING = 0
+        CMD_SET_GAIN = 1
+        CMD_ENABLE_OUTPUT = 2
+        CMD_DISABLE_OUTPUT = 3
+        CMD_ZERO_DISTANCE = 4
+        CMD_RESET_STATS = 5
+        CMD_GET_STATS = 6
+
+        CMD_SYNC = 165
+        ACK_SYNC = 90
+        ACK_BYTES = 16
+        STATUS_NAMES = {'ok', 'unknown command', 'queue full', 'invalid'}
+    end
+
+
+
+    methods
+        function obj = TeensyChannel(config)
+            % Constructor for a :class:`rc.classes.TeensyChannel` device.
+            %
+            % :param config: The main configuration structure.
+
+            obj.enabled = config.teensy_channel.enable;
+            if ~obj.enabled, return, end
+
+            obj.port = config.teensy_channel.port;
+            obj.timeout = config.teensy_channel.timeout;
+            obj.n_attempts = config.teensy_channel.n_attempts;
+
+            % Start at a random sequence number, so that the first command is
+            % not taken for a resend of the last one before a restart.
+            obj.sequence = randi(65535);
+
+            % The baud rate is ignored by USB serial.
+            obj.serial = serialport(obj.port, 9600, 'Timeout', obj.timeout);
+        end
+
+
+
+        function delete(obj)
+            % Destructor, closes the serial port.
+
+            obj.serial = [];
+        end
+
+
+
+        function time_us = ping(obj)
+            % Get the time of the Teensy, to relate it to the time of the host.
+            %
+            % :return: Teensy time at which the ping was applied (us).
+
+            if ~obj.enabled, time_us = []; return, end
+            obj.send(obj.CMD_PING);
+            time_us = obj.last_time_us;
+        end
+
+
+
+        function set_gain(obj, gain, ramp_ms, execute_at)
+            % Ramp the gain of the velocity output.
+            %
+            % :param gain: Gain to ramp to.
+            % :param ramp_ms: Optional duration of the ramp (ms), default 0 to step.
+            % :param execute_at: Optional Teensy time (us, low 32 bits) at which to start, default 0 for now.
+
+            VariableDefault('ramp_ms', 0);
+            VariableDefault('execute_at', 0);
+
+            if ~obj.enabled, return, end
+            obj.send(obj.CMD_SET_GAIN, gain, ramp_ms, execute_at);
+        end
+
+
+
+        function enable_output(obj)
+            % Let the velocity output follow the encoder.
+
+            if ~obj.enabled, return, end
+            obj.send(obj.CMD_ENABLE_OUTPUT);
+        end
+
+
+
+        function disable_output(obj)
+            % Hold the velocity output at the offset voltage.
+
+            if ~obj.enabled, return, end
+            obj.send(obj.CMD_DISABLE_OUTPUT);
+        end
+
+
+
+        function zero_distance(obj)
+            % Reset the distance of the encoder to zero.
+
+            if ~obj.enabled, return, end
+            obj.send(obj.CMD_ZERO_DISTANCE);
+        end
+
+
+
+        function reply = send(obj, command, value1, value2, execute_at)
+            % Send a command and wait for its acknowledgement.
+            %
+            % :param command: Command code, one of the CMD_ constants.
+            % :param value1: Optional first value of the command, default 0.
+            % :param value2: Optional second value of the command, default 0.
+            % :param execute_at: Optional Teensy time (us, low 32 bits) at which to apply the command, default 0 for now.
+            % :return: The reply sent after the acknowledgement as uint8, empty if none.
+
+            VariableDefault('value1', 0);
+            VariableDefault('value2', 0);
+            VariableDefault('execute_at', 0);
+
+            % A scheduled command is acknowledged when applied, so also wait
+            % until then, estimating the Teensy time from the last acknowledgement.
+            timeout = obj.timeout;
+            if execute_at ~= 0
+                if isempty(obj.last_tic), obj.ping(); end
+                now_us = mod(obj.last_time_us + 1e6 * toc(obj.last_tic), 2^32);
+                ahead_us = mod(execute_at - now_us, 2^32);
+                if ahead_us < 2^31
+                    timeout = timeout + ahead_us / 1e6;
+                end
+            end
+
+            obj.sequence = mod(obj.sequence + 1, 65536);
+            packet = [uint8(obj.CMD_SYNC), uint8(command), ...
+                      typecast(uint16(obj.sequence), 'uint8'), ...
+                      typecast(uint32(execute_at), 'uint8'), ...
+                      typecast(single(value1), 'uint8'), ...
+                      typecast(single(value2), 'uint8')];
+            packet(end+1) = uint8(mod(-sum(double(packet)), 256));
+
+            for attempt = 1 : obj.n_attempts
+                % Anything left over belongs to an earlier command.
+                flush(obj.serial, 'input');
+                write(obj.serial, packet, 'uint8');
+
+                [ack, reply] = obj.read_ack(command, timeout);
+                if isempty(ack), continue, end
+
+                status = ack(5);
+                obj.last_time_us = double(typecast(ack(9:16), 'uint64'));
+                obj.last_tic = tic;
+                if status ~= 0
+                    error('Teensy command %i failed: %s', command, obj.STATUS_NAMES{status+1});
+                end
+                return
+            end
+
+            error('Teensy command %i was not acknowledged on %s', command, obj.port);
+        end
+    end
+
+
+
+    methods (Access = private)
+        function [ack, reply] = read_ack(obj, command, timeout)
+            % Read the acknowledgement of the command just sent, skipping
+            % bytes until a valid one. Empty if none arrives within timeout (s).
+
+            ack = [];
+            reply = [];
+            buffer = uint8([]);
+            t = tic;
+
+            while toc(t) < timeout
+                n = obj.serial.NumBytesAvailable;
+                if n > 0
+                    buffer = [buffer, read(obj.serial, n, 'uint8')]; %#ok<AGROW>
+                else
+                    pause(0.001);
+                end
+
+                % Resynchronise on the next sync byte if the candidate is not valid.
+                while numel(buffer) >= obj.ACK_BYTES
+                    start = find(buffer == obj.ACK_SYNC, 1);
+                    if isempty(start), buffer = uint8([]); break, end
+                    buffer = buffer(start:end);
+                    if numel(buffer) < obj.ACK_BYTES, break, end
+
+                    candidate = buffer(1:obj.ACK_BYTES);
+                    sequence = typecast(candidate(3:4), 'uint16');
+                    if mod(sum(double(candidate)), 256) == 0 && candidate(2) == command && sequence == obj.sequence
+                        ack = candidate;
+                        buffer = buffer(obj.ACK_BYTES+1:end);
+                        break
+                    end
+                    buffer = buffer(2:end);
+                end
+
+                if isempty(ack), continue, end
+
+                % The reply follows the acknowledgement.
+                reply_length = double(typecast(ack(7:8), 'uint16'));
+                if reply_length > numel(buffer)
+                    buffer = [buffer, read(obj.serial, reply_length - numel(buffer), 'uint8')];
+                end
+                reply = buffer(1:reply_length);
+                return
+            end
+        end
+    end
+end
@@ -21,6 +21,7 @@ classdef RC2Controller < handle
         start_soloist % :class:`rc.classes.StartSoloist`
         offsets % :class:`rc.classes.Offsets`
         teensy_gain % :class:`rc.classes.TeensyGain`
+        teensy_channel % :class:`rc.classes.TeensyChannel`
         delayed_velocity % :class:`rc.classes.DelayedVelocity`
         lick_detector
     end
@@ -71,6 +72,7 @@ classdef RC2Controller < handle
             obj.vis_stim = VisStim(obj.ni, config);
             obj.start_soloist = StartSoloist(obj.ni, config);
             obj.teensy_gain = TeensyGain(obj.ni, config);
+            obj.teensy_channel = TeensyChannel(config);
         end
         
         
@@ -145,6 +147,9 @@ classdef RC2Controller < handle
             end
             
             obj.saver.setup_logging();
+            if obj.saver.enable
+                obj.soloist.set_collect_prefix(obj.saver.soloist_fname_prefix());
+            end
             obj.ni.prepare_acq(@(x, y)obj.h_callback(x, y))
             obj.plotting.reset_vals();
             obj.lick_detector.reset();
@@ -194,6 +199,7 @@ classdef RC2Controller < handle
             
             obj.acquiring = false;
             obj.ni.stop_acq();
+            obj.soloist.set_collect_prefix('');
             obj.saver.stop_logging();
         end
         
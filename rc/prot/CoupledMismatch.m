@@ -208,6 +208,10 @@ classdef CoupledMismatch < handle
                 % to wait at the start position anyway...
                 obj.ctl.soloist.listen_until(obj.back_limit, obj.forward_limit);
                 
+                % load the programs of the first gear command of the next trial
+                % while this one runs (only with the daemon)
+                obj.ctl.soloist.prepare('calibrate_zero');
+                
                 % switch vis stim on
                 if obj.enable_vis_stim
                     obj.ctl.vis_stim.on();
@@ -255,6 +255,10 @@ classdef Loco2LocoVest < handle
                 reward_position = obj.start_pos - (obj.switch_pos - obj.forward_limit);
                 obj.ctl.soloist.mismatch_ramp_up_until(obj.back_limit, reward_position)
                 
+                % load the programs of the first gear command of the next trial
+                % while this one runs (only with the daemon)
+                obj.ctl.soloist.prepare('mismatch_ramp_up_until');
+                
                  % start integrating position on PC
                 obj.ctl.position.start();
                 
@@ -237,6 +237,10 @@ classdef LocoVest2Loco < handle
                 % go into the mismatch condition
                 obj.ctl.soloist.mismatch_ramp_down_at(obj.back_limit, obj.switch_pos);
                 
+                % load the programs of the first gear command of the next trial
+                % while this one runs (only with the daemon)
+                obj.ctl.soloist.prepare('mismatch_ramp_down_at');
+                
                 % start integrating position on PC
                 obj.ctl.position.start();
                 
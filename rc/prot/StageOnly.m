@@ -271,6 +271,10 @@ classdef StageOnly < handle
                 % don't wait for trigger
                 obj.ctl.soloist.listen_until(obj.back_limit, obj.forward_limit, false);
                 
+                % load the programs of the first gear command of the next trial
+                % while this one runs (only with the daemon)
+                obj.ctl.soloist.prepare('calibrate_zero');
+                
                 % Reset the idle voltage on the NI as we are now in gear
                 % mode
                 obj.ctl.set_ni_ao_idle('up', 'on');
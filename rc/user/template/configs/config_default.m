@@ -130,6 +130,11 @@ config.teensy.exe               = 'C:\Program Files (x86)\Arduino\arduino_debug.
 config.teensy.dir               = fullfile(config.environment_dir, 'teensy_ino');
 config.teensy.start_script      = 'forward_only';
 
+config.teensy_channel.enable    = false;   % send commands over USB serial (script compiled with COMMAND_CHANNEL)
+config.teensy_channel.port      = 'COM3';  % serial port of the Teensy
+config.teensy_channel.timeout   = 0.1;     % time to wait for each acknowledgement (s)
+config.teensy_channel.n_attempts = 3;      % number of times a command is sent before giving up
+
 
 %%%%%%%%%%%%%%%%%%%%%%
 % SOLOIST parameters %
@@ -141,6 +146,12 @@ config.soloist.v_per_cm_per_s   = 2.5/100;
 config.soloist.ai_offset        = -500.0;
 config.soloist.gear_scale       = -400000;
 config.soloist.deadband         = 0.005;
+config.soloist.use_daemon       = false;   % run commands on daemon.exe instead of one executable per command
+config.soloist.ramp_up_us       = 200000;  % duration of the ramp up of the gear scale factor (us)
+config.soloist.ramp_down_us     = 500000;  % duration of the ramp down at the position limits (us)
+config.soloist.ramp_shape       = 'linear'; % 'linear', 'cosine', 's_curve' or 'table'
+config.soloist.ramp_table       = [0, 1];  % fraction of the ramp at evenly spaced times, for 'table' (up to 16 values)
+config.soloist.collect_rate_hz  = 0;       % sample rate (Hz) of data collection on the controller during gear commands, 0 for none
 
 
 
@@ -26,12 +26,14 @@ main () {
             usleep(5000);
             if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
             printf("aborted...\n");
-            // Reset gear parameters
+            // Stop the safety monitor and reset gear parameters
+            stop_monitor(handles, handle_count);
             reset_gear(handles, handle_count);
             
         } else if (line.compare("close") == 0) {
             
-            // Reset gear parameters
+            // Stop the safety monitor and reset gear parameters
+            stop_monitor(handles, handle_count);
             reset_gear(handles, handle_count);
             if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
             if(!SoloistDisconnect(handles)) { cleanup(handles, handle_count); }
@@ -41,7 +43,8 @@ main () {
             
             if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
             printf("stopped...\n");
-            // Reset gear parameters
+            // Stop the safety monitor and reset gear parameters
+            stop_monitor(handles, handle_count);
             reset_gear(handles, handle_count);
             
         } else if (line.compare("reset_pso") == 0) {
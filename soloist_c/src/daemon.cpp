@@ -0,0 +1,459 @@
+/*
+daemon.cpp
+Stays connected to the Soloist and runs the same operations as the single-command
+executables, so that trials do not pay for process start-up and SoloistConnect.
+
+Commands are read one per line from standard input. Arguments are as for the
+executable of the same name, and paths containing spaces may be quoted:
+
+    home
+    reset
+    move_to <position> <speed> <leave_enabled>
+    calibrate_zero <backward_limit> <forward_limit> <ai_offset> <leave_enabled> <ab_dir>
+    listen_until <backward_limit> <forward_limit> <ai_offset> <gear_scale> <deadband> <wait_for_trigger> <ab_dir> [ramp] [--collect <path> [rate_hz]]
+    mismatch_ramp_up_until <backward_limit> <forward_limit> <ai_offset> <gear_scale> <deadband> <ab_dir> [ramp] [--collect <path> [rate_hz]]
+    mismatch_ramp_down_at <backward_limit> <forward_limit> <ai_offset> <gear_scale> <deadband> <ab_dir> [ramp] [--collect <path> [rate_hz]]
+    prepare <operation> <ab_dir>
+    status
+    abort | stop | reset_pso | close
+
+Operations run one at a time on a worker thread, so abort, stop and status are
+answered while one is running. abort and stop wait up to ABORT_JOIN_MS for the
+operation to return; if it has not, the daemon stays busy with it until it does,
+and close waits for it. Each line gets one reply line:
+"started <op>", "busy <op>", "idle", "error <message>", or the replies of abort.exe
+("aborted...", "stopped...", "pso_reset...", "shutdown..."). When an operation
+finishes the worker prints "done <op> <result>", where result is the mean analog
+input for calibrate_zero, RC_SUCCESS/RC_FAILED/RC_ABORTED for the gear sessions
+and 0 otherwise.
+
+prepare loads the programs of the next gear session (calibrate_zero, listen_until or
+mismatch_*) into the tasks the running session does not use, and is answered with
+"prepared <op>" straight away. The next operation of that name starts from it. While an
+operation runs the programs are loaded on the worker, between its polls of the safety
+monitor or else once the operation is over, so that the two threads do not use the
+controller at the same time; otherwise they are loaded before the reply. The data
+collection is also drained on the worker, between its polls (see rc_collect.c). Only
+abort and stop use the controller from the main thread while an operation runs.
+
+As in the executables, an error from the Soloist library disconnects and exits.
+*/
+
+#include "rc_soloist.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <tchar.h>
+
+// Time to wait for the operation to return after an abort (ms)
+#define ABORT_JOIN_MS   5000
+
+
+static SoloistHandle *handles;
+static DWORD handle_count = 0;
+
+// Replies come from both threads, so each line is written whole.
+static CRITICAL_SECTION reply_lock;
+
+// The operation being run by the worker.
+static HANDLE worker = NULL;
+static std::vector<std::string> job;
+static RcSession job_session = {RC_OP_NONE};
+static RcRamp job_ramp;
+static RcCollect job_collect;
+
+// Session loaded ahead by prepare, for the next operation of its kind.
+static RcSession prepared = {RC_OP_NONE};
+
+// A prepare waiting for the worker, which loads it while worker_running is set.
+static CRITICAL_SECTION prepare_lock;
+static bool worker_running = false;
+static int prepare_op = RC_OP_NONE;
+static std::string prepare_ab_dir;
+
+
+
+static void
+reply(const char *format, ...)
+{
+    // Format the whole line first and write it in one go, so that replies from the
+    // worker and the main thread are never mixed on one line.
+    static char line[TELEMETRY_REPORT_LENGTH + 256];
+    va_list args;
+    va_start(args, format);
+    EnterCriticalSection(&reply_lock);
+    int n = vsnprintf(line, sizeof(line) - 1, format, args);
+    if (n < 0) n = 0;
+    if (n > (int) sizeof(line) - 2) n = sizeof(line) - 2;
+    line[n++] = '\n';
+    fwrite(line, 1, n, stdout);
+    fflush(stdout);
+    LeaveCriticalSection(&reply_lock);
+    va_end(args);
+}
+
+
+
+static std::vector<std::string>
+split(const std::string &line)
+{
+    // Split on whitespace, keeping double-quoted arguments whole.
+    std::vector<std::string> words;
+    std::string word;
+    bool quoted = false, in_word = false;
+
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (c == '"') {
+            quoted = !quoted;
+            in_word = true;
+        } else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+            if (in_word) words.push_back(word);
+            word.clear();
+            in_word = false;
+        } else {
+            word += c;
+            in_word = true;
+        }
+    }
+    if (in_word) words.push_back(word);
+    return words;
+}
+
+
+
+static int
+session_op(const std::string &op)
+{
+    if (op == "calibrate_zero") return RC_OP_CALIBRATE_ZERO;
+    if (op == "listen_until") return RC_OP_LISTEN_UNTIL;
+    if (op == "mismatch_ramp_up_until") return RC_OP_MISMATCH_RAMP_UP_UNTIL;
+    if (op == "mismatch_ramp_down_at") return RC_OP_MISMATCH_RAMP_DOWN_AT;
+    return RC_OP_NONE;
+}
+
+
+
+static void
+reply_message(const char *line)
+{
+    // Messages of the operations, printed by SoloistDaemonProc
+    reply("%s", line);
+}
+
+
+
+static void
+reply_telemetry(const char *line)
+{
+    // The timing of a session, read by SoloistDaemonProc
+    reply("telemetry %s", line);
+}
+
+
+
+static void
+load_prepared()
+{
+    // Carry out the waiting prepare, if any. prepare_lock is held by the caller, which is
+    // the only thread using the controller.
+    if (prepare_op == RC_OP_NONE) return;
+    rc_prepare_session(handles, handle_count, prepare_op, (char *) prepare_ab_dir.c_str(), &prepared);
+    prepare_op = RC_OP_NONE;
+}
+
+
+
+static void
+load_prepared_between_polls()
+{
+    // rc_session_idle, on the worker.
+    EnterCriticalSection(&prepare_lock);
+    load_prepared();
+    LeaveCriticalSection(&prepare_lock);
+}
+
+
+
+static DWORD WINAPI
+run_job(LPVOID unused)
+{
+    std::vector<std::string> &a = job;
+    const std::string &op = a[0];
+    DOUBLE result = 0;
+
+    if (op == "home") {
+        rc_home(handles, handle_count);
+    } else if (op == "reset") {
+        rc_reset(handles, handle_count);
+    } else if (op == "move_to") {
+        rc_move_to(handles, handle_count, atof(a[1].c_str()), atof(a[2].c_str()), atoi(a[3].c_str()));
+    } else if (op == "calibrate_zero") {
+        result = rc_calibrate_zero(handles, handle_count, atof(a[1].c_str()), atof(a[2].c_str()), atof(a[3].c_str()),
+                                   atoi(a[4].c_str()), (char *) a[5].c_str(), &job_session);
+    } else if (op == "listen_until") {
+        result = rc_listen_until(handles, handle_count, atof(a[1].c_str()), atof(a[2].c_str()), atof(a[3].c_str()),
+                                 atof(a[4].c_str()), atof(a[5].c_str()), atoi(a[6].c_str()), (char *) a[7].c_str(),
+                                 &job_ramp, &job_collect, &job_session);
+    } else if (op == "mismatch_ramp_up_until") {
+        result = rc_mismatch_ramp_up_until(handles, handle_count, atof(a[1].c_str()), atof(a[2].c_str()), atof(a[3].c_str()),
+                                           atof(a[4].c_str()), atof(a[5].c_str()), (char *) a[6].c_str(),
+                                           &job_ramp, &job_collect, &job_session);
+    } else if (op == "mismatch_ramp_down_at") {
+        result = rc_mismatch_ramp_down_at(handles, handle_count, atof(a[1].c_str()), atof(a[2].c_str()), atof(a[3].c_str()),
+                                          atof(a[4].c_str()), atof(a[5].c_str()), (char *) a[6].c_str(),
+                                          &job_ramp, &job_collect, &job_session);
+    }
+
+    // A prepare which came too late, or during an operation without a monitor, is loaded
+    // now, before the next operation can start. After an abort the next operation loads
+    // its own programs instead.
+    EnterCriticalSection(&prepare_lock);
+    if (rc_abort_requested) {
+        prepare_op = RC_OP_NONE;
+    }
+    load_prepared();
+    worker_running = false;
+    LeaveCriticalSection(&prepare_lock);
+
+    reply("done %s %.10f", op.c_str(), result);
+    return 0;
+}
+
+
+
+static bool
+busy()
+{
+    return worker != NULL && WaitForSingleObject(worker, 0) == WAIT_TIMEOUT;
+}
+
+
+
+static bool
+join_worker(DWORD timeout_ms)
+{
+    // Returns whether the worker has finished. One still running after timeout_ms is
+    // kept, so that busy() reports it and no second operation is started alongside it.
+    if (worker == NULL) return true;
+    if (WaitForSingleObject(worker, timeout_ms) != WAIT_OBJECT_0) return false;
+    CloseHandle(worker);
+    worker = NULL;
+    return true;
+}
+
+
+
+static void
+start_job(const std::vector<std::string> &words)
+{
+    // Minimum number of words (including the operation) for each operation.
+    const char *ops[] = {"home", "reset", "move_to", "calibrate_zero", "listen_until", "mismatch_ramp_up_until", "mismatch_ramp_down_at"};
+    const size_t n_words[] = {1, 1, 4, 6, 8, 7, 7};
+
+    for (size_t i = 0; i < sizeof(n_words) / sizeof(n_words[0]); i++) {
+        if (words[0] != ops[i]) continue;
+
+        if (words.size() < n_words[i]) {
+            reply("error %s needs %d arguments", ops[i], (int) n_words[i] - 1);
+            return;
+        }
+        if (busy()) {
+            reply("busy %s", job[0].c_str());
+            return;
+        }
+
+        // Tidy up after the previous operation, which has returned.
+        join_worker(0);
+
+        // The worker keeps its own copy of the words, which the parsed arguments point into.
+        job = words;
+
+        // Any words after the required ones are the ramp and data collection of a gear session.
+        std::vector<char *> extra;
+        for (size_t j = n_words[i]; j < job.size(); j++) {
+            extra.push_back((char *) job[j].c_str());
+        }
+        int n_ramp_words = rc_parse_collect((int) extra.size(), extra.data(), &job_collect);
+        if (n_ramp_words < 0) {
+            reply("error data collection arguments are: --collect path [rate_hz]");
+            return;
+        }
+        if (rc_parse_ramp(n_ramp_words, extra.data(), &job_ramp) != 0) {
+            reply("error ramp arguments are: up_us down_us [linear|cosine|s_curve|table v0 ... vn]");
+            return;
+        }
+
+        // Hand over the prepared session if it is for this operation. One for another gear
+        // operation is dropped, as this one may load its own programs into the same tasks.
+        job_session.op = RC_OP_NONE;
+        if (session_op(words[0]) != RC_OP_NONE) {
+            if (prepared.op == session_op(words[0])) {
+                job_session = prepared;
+            }
+            prepared.op = RC_OP_NONE;
+        }
+
+        InterlockedExchange(&rc_abort_requested, 0);
+        EnterCriticalSection(&prepare_lock);
+        worker_running = true;
+        LeaveCriticalSection(&prepare_lock);
+        worker = CreateThread(NULL, 0, run_job, NULL, 0, NULL);
+        if (worker == NULL) {
+            worker_running = false;
+            reply("error could not start %s", ops[i]);
+            return;
+        }
+        reply("started %s", ops[i]);
+        return;
+    }
+
+    reply("error unknown command %s", words[0].c_str());
+}
+
+
+
+static void
+prepare_job(const std::vector<std::string> &words)
+{
+    int op = (words.size() > 1) ? session_op(words[1]) : RC_OP_NONE;
+
+    if (op == RC_OP_NONE || words.size() < 3) {
+        reply("error prepare needs a gear operation and the ab directory");
+        return;
+    }
+
+    // The worker's session is on the other tasks, as rc_prepare_session() alternates
+    // them (or reuses the last prepared ones). A later prepare replaces a waiting one.
+    EnterCriticalSection(&prepare_lock);
+    prepare_op = op;
+    prepare_ab_dir = words[2];
+    if (!worker_running) {
+        load_prepared();
+    }
+    LeaveCriticalSection(&prepare_lock);
+    reply("prepared %s", words[1].c_str());
+}
+
+
+
+static void
+drop_prepared()
+{
+    // After an abort or stop the next operation loads its own programs, as for a
+    // prepare still waiting for the worker.
+    EnterCriticalSection(&prepare_lock);
+    prepare_op = RC_OP_NONE;
+    prepared.op = RC_OP_NONE;
+    LeaveCriticalSection(&prepare_lock);
+}
+
+
+
+static bool
+stop_job(DWORD timeout_ms)
+{
+    // Ask the operation to return without touching the stage again, then wait for it.
+    // Returns whether it has returned.
+    if (busy()) {
+        InterlockedExchange(&rc_abort_requested, 1);
+    }
+    return join_worker(timeout_ms);
+}
+
+
+
+int
+main () {
+
+    InitializeCriticalSection(&reply_lock);
+    InitializeCriticalSection(&prepare_lock);
+    rc_session_idle = load_prepared_between_polls;
+    telemetry_output = reply_telemetry;
+    rc_output = reply_message;
+
+    // Connect to soloist.
+    if(!SoloistConnect(&handles, &handle_count)) { cleanup(handles, handle_count); }
+
+
+    for(std::string line; std::getline(std::cin, line);) {
+
+        std::vector<std::string> words = split(line);
+        if (words.empty()) continue;
+
+        if (words[0] == "abort") {
+
+            // Stop the motion first, before waiting for the operation to notice.
+            InterlockedExchange(&rc_abort_requested, 1);
+            if(!SoloistMotionAbort(handles[0])) { cleanup(handles, handle_count); }
+            bool returned = stop_job(ABORT_JOIN_MS);
+            drop_prepared();
+            stop_monitor(handles, handle_count);
+            usleep(5000);
+            if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
+            // Reset gear parameters
+            reset_gear(handles, handle_count);
+            if (returned) {
+                reply("aborted...");
+            } else {
+                reply("aborted... %s has not returned", job[0].c_str());
+            }
+
+        } else if (words[0] == "close") {
+
+            // The connection cannot be closed under the operation.
+            stop_job(INFINITE);
+            stop_monitor(handles, handle_count);
+            // Reset gear parameters
+            reset_gear(handles, handle_count);
+            if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
+            if(!SoloistDisconnect(handles)) { cleanup(handles, handle_count); }
+            reply("shutdown...");
+            break;
+
+        } else if (words[0] == "stop") {
+
+            InterlockedExchange(&rc_abort_requested, 1);
+            if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
+            bool returned = stop_job(ABORT_JOIN_MS);
+            drop_prepared();
+            stop_monitor(handles, handle_count);
+            // Reset gear parameters
+            reset_gear(handles, handle_count);
+            if (returned) {
+                reply("stopped...");
+            } else {
+                reply("stopped... %s has not returned", job[0].c_str());
+            }
+
+        } else if (words[0] == "reset_pso") {
+
+            if(!SoloistPSOControl(handles[0], PSOMODE_Reset)) { cleanup(handles, handle_count); }
+            reply("pso_reset...");
+
+        } else if (words[0] == "prepare") {
+
+            prepare_job(words);
+
+        } else if (words[0] == "status") {
+
+            if (busy()) {
+                reply("busy %s", job[0].c_str());
+            } else {
+                reply("idle");
+            }
+
+        } else {
+
+            start_job(words);
+        }
+    }
+
+    DeleteCriticalSection(&prepare_lock);
+    DeleteCriticalSection(&reply_lock);
+    return 0;
+}
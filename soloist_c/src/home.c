@@ -14,17 +14,8 @@ main(int argc, char **argv)
     // Connect to soloist.
     if(!SoloistConnect(&handles, &handle_count)) { cleanup(handles, handle_count); }
     
-    // Reset just in case
-    reset_gear(handles, handle_count);
-    
-    // Enable axis
-    if(!SoloistMotionEnable(handles[0])) { cleanup(handles, handle_count); }
-    
-    // Home the axis
-    if(!SoloistMotionHomeConditional(handles[0])) { cleanup(handles, handle_count); }
-    
     // Home the axis
-    if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
+    rc_home(handles, handle_count);
     
     // Disconnect from Soloist
     if(!SoloistDisconnect(handles)) { cleanup(handles, handle_count); }
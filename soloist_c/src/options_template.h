@@ -28,5 +28,26 @@
 #define DEFAULT_POSITION                20
 #define DEFAULT_SPEED					300
 
+// Waiting on the controller (see wait_until in rc_shared.c)
+#define WAIT_LATENCY_US                 5000    // tasks and the safety monitor finishing
+#define WAIT_TRIGGER_LATENCY_US         500     // the trigger input
+#define WAIT_SPIN_US                    1000    // poll continuously for this long,
+#define WAIT_YIELD_US                   10000   // then yield between polls until this, then sleep
+
+// Time for the safety monitor to start before it is loaded again (see start_monitor in rc_commands.c)
+#define MONITOR_START_MS                10
+
+// Default ramps of the gear scale factor (us), see rc_parse_ramp in rc_commands.c
+#define RAMP_UP_US                      200000
+#define RAMP_DOWN_US                    500000
+
+// File to which the timing of each gear session is appended as a line of JSON, "" for none (see rc_telemetry.c)
+#define TELEMETRY_PATH                  ""
+
+// Data collection during the gear sessions, see rc_collect.c
+#define COLLECT_RATE_HZ                 1000    // default sample rate
+#define COLLECT_MAX_SAMPLES             2400000 // the controller stops collecting after this many samples
+#define COLLECT_DRAIN_MS                50      // how often the samples are copied to the file
+
 
 #endif /* OPTIONS_H */
\ No newline at end of file
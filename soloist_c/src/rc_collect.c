@@ -0,0 +1,167 @@
+/*
+rc_collect.c
+Data collection on the controller during a gear session. The controller samples
+the signals at a fixed rate into its own buffer, so the rate does not depend on the
+poll loops of the host. The session's own thread drains the buffer to a binary file
+every COLLECT_DRAIN_MS, from collect_poll() in wait_until(), so that only one thread
+uses the controller (see daemon.cpp).
+
+The file starts with an RcCollectHeader, followed by the samples as float32,
+n_channels values per sample in the order of the channel names. The number of
+samples follows from the size of the file.
+*/
+
+
+
+#include "rc_soloist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+// Signals collected, in the order they are written to the file
+static const struct {
+    DATASIGNAL signal;
+    DWORD argument;
+    const char *name;
+} channels[COLLECT_N_CHANNELS] = {
+    {DATASIGNAL_PositionCommand,    0,              "position_command"},
+    {DATASIGNAL_PositionFeedback,   0,              "position_feedback"},
+    {DATASIGNAL_VelocityFeedback,   0,              "velocity_feedback"},
+    {DATASIGNAL_AnalogInput0,       0,              "analog_input"},
+    // GearCamScaleFactor is a parameter, so the ramp programs mirror it to a global
+    {DATASIGNAL_GlobalDouble,       RAMP_SCALE,     "gear_scale"},
+};
+
+
+// The collection in progress. The controller has one collection at a time.
+static SoloistHandle *collect_handles = NULL;
+static DWORD collect_handle_count = 0;
+static SoloistDataCollectConfigHandle collect_config;
+static FILE *collect_file = NULL;
+static DWORD collect_last_drain = 0;        // GetTickCount() of the last drain
+
+
+
+static void
+drain(DWORD n_available)
+{
+    // Retrieve samples from the controller (one block per signal) and append them interleaved.
+    static DOUBLE data[COLLECT_N_CHANNELS * COLLECT_BLOCK_SAMPLES];
+    static float samples[COLLECT_N_CHANNELS * COLLECT_BLOCK_SAMPLES];
+
+    while (n_available > 0) {
+        DWORD n = (n_available < COLLECT_BLOCK_SAMPLES) ? n_available : COLLECT_BLOCK_SAMPLES;
+        if(!SoloistDataCollectionDataRetrieve(collect_handles[0], n, data)) { cleanup(collect_handles, collect_handle_count); }
+
+        for (DWORD i = 0; i < n; i++) {
+            for (int j = 0; j < COLLECT_N_CHANNELS; j++) {
+                samples[i * COLLECT_N_CHANNELS + j] = (float) data[j * n + i];
+            }
+        }
+        fwrite(samples, sizeof(float), n * COLLECT_N_CHANNELS, collect_file);
+        n_available -= n;
+    }
+}
+
+
+
+void
+collect_poll(SoloistHandle *handles, DWORD handle_count)
+{
+    // Keep the controller buffer from filling up. Called on every poll of wait_until(), but
+    // only drains every COLLECT_DRAIN_MS, and does nothing without a collection.
+    if (collect_file == NULL || GetTickCount() - collect_last_drain < COLLECT_DRAIN_MS) return;
+    collect_last_drain = GetTickCount();
+
+    DWORD n_available;
+    if(!SoloistDataCollectionStatusGet(handles[0], &n_available)) { cleanup(handles, handle_count); }
+    drain(n_available);
+}
+
+
+
+int
+rc_parse_collect(int argc, char **argv, RcCollect *collect)
+{
+    // Optional data collection arguments of the gear executables and daemon commands,
+    // after any ramp arguments:
+    //     --collect <path> [rate_hz]
+    // Returns the number of arguments before them, or -1 if they are not valid.
+    collect->path = NULL;
+    collect->rate_hz = COLLECT_RATE_HZ;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--collect") != 0) continue;
+
+        if (i + 1 >= argc || i + 3 < argc) return -1;
+        collect->path = argv[i + 1];
+        if (i + 2 < argc) collect->rate_hz = atof(argv[i + 2]);
+        if (collect->rate_hz <= 0 || collect->rate_hz > COLLECT_MAX_RATE_HZ) return -1;
+        return i;
+    }
+    return argc;
+}
+
+
+
+void
+collect_start(SoloistHandle *handles, DWORD handle_count, const RcCollect *collect)
+{
+    // Start sampling on the controller, collect_poll() then writes the samples to collect->path.
+    // Does nothing without a path. A file which cannot be opened is reported and skipped,
+    // as the session itself can still run.
+    if (collect == NULL || collect->path == NULL || collect_file != NULL) return;
+
+    collect_file = fopen(collect->path, "wb");
+    if (collect_file == NULL) {
+        rc_message("could not open %s, not collecting data", collect->path);
+        return;
+    }
+
+    RcCollectHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLLECT_MAGIC, sizeof(header.magic));
+    header.version = COLLECT_VERSION;
+    header.n_channels = COLLECT_N_CHANNELS;
+    header.rate_hz = collect->rate_hz;
+    GetSystemTimeAsFileTime(&header.start_time);
+    for (int j = 0; j < COLLECT_N_CHANNELS; j++) {
+        strncpy(header.channel_names[j], channels[j].name, COLLECT_NAME_LENGTH - 1);
+    }
+
+    collect_handles = handles;
+    collect_handle_count = handle_count;
+
+    // Sample until stopped (or COLLECT_MAX_SAMPLES), collect_poll() keeps the buffer from overflowing.
+    if(!SoloistDataCollectionConfigCreate(handles[0], &collect_config)) { cleanup(handles, handle_count); }
+    for (int j = 0; j < COLLECT_N_CHANNELS; j++) {
+        if(!SoloistDataCollectionConfigAddSignal(collect_config, channels[j].signal, channels[j].argument)) { cleanup(handles, handle_count); }
+    }
+    if(!SoloistDataCollectionConfigSetPeriod(collect_config, 1000.0 / collect->rate_hz)) { cleanup(handles, handle_count); }
+    if(!SoloistDataCollectionConfigSetSamples(collect_config, COLLECT_MAX_SAMPLES)) { cleanup(handles, handle_count); }
+    if(!SoloistDataCollectionStart(handles[0], collect_config)) { cleanup(handles, handle_count); }
+
+    // The start time in the header was taken just before sampling started.
+    fwrite(&header, sizeof(header), 1, collect_file);
+    collect_last_drain = GetTickCount();
+}
+
+
+
+void
+collect_stop(SoloistHandle *handles, DWORD handle_count)
+{
+    // Stop sampling, write the last samples and close the file.
+    if (collect_file == NULL) return;
+
+    DWORD n_available;
+    if(!SoloistDataCollectionStop(handles[0])) { cleanup(handles, handle_count); }
+    if(!SoloistDataCollectionStatusGet(handles[0], &n_available)) { cleanup(handles, handle_count); }
+    drain(n_available);
+
+    SoloistDataCollectionConfigFree(collect_config);
+    fclose(collect_file);
+    collect_file = NULL;
+}
@@ -0,0 +1,709 @@
+/*
+rc_commands.c
+The operations carried out on the Soloist, shared by the single-command
+executables and by daemon.cpp, which runs them on one long-lived connection.
+
+Each operation assumes an open connection. Errors from the Soloist library
+go to cleanup(), which disconnects and exits, as before.
+*/
+
+
+
+#include "rc_soloist.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tchar.h>
+
+
+
+static int
+trigger_low(SoloistHandle *handles, DWORD handle_count, void *unused)
+{
+    RcStatus status;
+    read_status(handles, handle_count, &status);
+    return status.digital_input != 1;
+}
+
+
+
+static void
+wait_for_trigger(SoloistHandle *handles, DWORD handle_count)
+{
+    // Wait for a trigger to go low (digital input starts high).
+    wait_until(handles, handle_count, trigger_low, NULL, WAIT_TRIGGER_LATENCY_US);
+}
+
+
+
+// The programs of a gear session are loaded into one of two pairs of tasks, in turn,
+// so that the next session can be loaded while the last one is still running.
+static const TASKID ramp_tasks[] = {TASKID_01, TASKID_03};
+static const TASKID monitor_tasks[] = {TASKID_02, TASKID_04};
+static volatile LONG n_sessions = 0;
+
+
+
+static void
+load_program(SoloistHandle *handles, DWORD handle_count, TASKID task, char *ab_directory, char *suffix)
+{
+    // The controller compiles a program each time it is loaded. Each task keeps the hash of
+    // the source it was loaded from, so a program that has not changed is left loaded and
+    // only started again. Editing the .ab file or one of its includes changes the hash.
+    char *ab_script = get_ab_path(ab_directory, suffix);
+    DWORD hash_index = PROGRAM_HASH + (task - TASKID_01);
+    DOUBLE hash = hash_program(ab_script);
+    DOUBLE loaded_hash;
+    TASKSTATE task_state;
+
+    if(!SoloistVariableGetGlobalDoubles(handles[0], hash_index, &loaded_hash, 1)) { cleanup(handles, handle_count); }
+    if(!SoloistProgramGetTaskState(handles[0], task, &task_state)) { cleanup(handles, handle_count); }
+
+    if (loaded_hash != hash || (task_state != TASKSTATE_ProgramReady && task_state != TASKSTATE_ProgramComplete)) {
+        // Forget the old program first, in case the load fails part way
+        DOUBLE unknown = 0;
+        if(!SoloistVariableSetGlobalDoubles(handles[0], hash_index, &unknown, 1)) { cleanup(handles, handle_count); }
+        if(!SoloistProgramLoad(handles[0], task, ab_script)) { cleanup(handles, handle_count); }
+        if(!SoloistVariableSetGlobalDoubles(handles[0], hash_index, &hash, 1)) { cleanup(handles, handle_count); }
+    }
+    free(ab_script);
+}
+
+
+
+static RcSession *
+use_session(SoloistHandle *handles, DWORD handle_count, int op, char *ab_directory, RcSession *prepared, RcSession *local)
+{
+    // Use the prepared session if it was loaded for this operation, otherwise load one now.
+    if (prepared != NULL && prepared->op == op) {
+        return prepared;
+    }
+    local->op = RC_OP_NONE;
+    rc_prepare_session(handles, handle_count, op, ab_directory, local);
+    return local;
+}
+
+
+
+static void
+start_ramps(SoloistHandle *handles, DWORD handle_count, const RcRamp *ramp, DOUBLE start_scale, DOUBLE gear_scale,
+            int wait_for_trigger_input)
+{
+    DOUBLE globals[RAMP_N_GLOBALS];
+    RcRamp default_ramp;
+
+    if (ramp == NULL) {
+        rc_default_ramp(&default_ramp);
+        ramp = &default_ramp;
+    }
+
+    // Ramp up from start_scale to gear_scale. The monitor ramps down from wherever the gain is.
+    for (int i = 0; i < RAMP_N_GLOBALS; i++) {
+        globals[i] = 0;
+    }
+    globals[RAMP_FROM - RAMP_FROM] = start_scale;
+    globals[RAMP_TO - RAMP_FROM] = gear_scale;
+    globals[RAMP_OVER_US - RAMP_FROM] = ramp->up_us;
+    globals[RAMP_WAIT_TRIGGER - RAMP_FROM] = wait_for_trigger_input;
+    globals[RAMP_DOWN_OVER_US - RAMP_FROM] = ramp->down_us;
+    globals[RAMP_SHAPE - RAMP_FROM] = ramp->shape;
+    globals[RAMP_SCALE - RAMP_FROM] = start_scale;
+    for (int i = 0; i < RAMP_TABLE_POINTS; i++) {
+        globals[RAMP_TABLE - RAMP_FROM + i] = ramp->table[i];
+    }
+    if(!SoloistVariableSetGlobalDoubles(handles[0], RAMP_FROM, globals, RAMP_N_GLOBALS)) { cleanup(handles, handle_count); }
+}
+
+
+
+typedef struct {
+    LONGLONG deadline;                  // telemetry_now() after which we give up
+    int started;
+} RcMonitorStart;
+
+
+
+static int
+monitor_started(SoloistHandle *handles, DWORD handle_count, void *data)
+{
+    RcMonitorStart *start = (RcMonitorStart *) data;
+    DOUBLE state;
+
+    if(!TIMED(TELEMETRY_GET_GLOBAL_DOUBLES, SoloistVariableGetGlobalDoubles(handles[0], MONITOR_STATE, &state, 1))) { cleanup(handles, handle_count); }
+    start->started = (state != MONITOR_NOT_STARTED);
+    return start->started || telemetry_now() > start->deadline;
+}
+
+
+
+static int
+run_monitor(SoloistHandle *handles, DWORD handle_count, TASKID task)
+{
+    // Start the monitor and wait for its first statement to set MONITOR_STATE. Returns 1 once
+    // it has, 0 if it did not within MONITOR_START_MS or an abort was requested first.
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    DOUBLE state = MONITOR_NOT_STARTED;
+    if(!SoloistVariableSetGlobalDoubles(handles[0], MONITOR_STATE, &state, 1)) { cleanup(handles, handle_count); }
+
+    if(!TIMED(TELEMETRY_PROGRAM_START, SoloistProgramStart(handles[0], task))) { cleanup(handles, handle_count); }
+
+    RcMonitorStart start;
+    start.deadline = telemetry_now() + MONITOR_START_MS * frequency.QuadPart / 1000;
+    start.started = 0;
+    wait_until(handles, handle_count, monitor_started, &start, WAIT_TRIGGER_LATENCY_US);
+    return start.started;
+}
+
+
+
+static void
+start_monitor(SoloistHandle *handles, DWORD handle_count, RcSession *session, char *ab_directory,
+              DOUBLE backward_limit, DOUBLE forward_limit, int ramp_down)
+{
+    DOUBLE globals[MONITOR_N_GLOBALS];
+
+    // Limits for the monitor. The exit reason is cleared here so that we never read the last session's.
+    globals[MONITOR_BACKWARD_LIMIT] = backward_limit;
+    globals[MONITOR_FORWARD_LIMIT] = forward_limit;
+    globals[MONITOR_SPEED_LIMIT] = SPEED_LIMIT;
+    globals[MONITOR_RAMP_DOWN] = ramp_down;
+    globals[MONITOR_STOP] = 0;
+    globals[MONITOR_EXIT] = MONITOR_RUNNING;
+    if(!SoloistVariableSetGlobalDoubles(handles[0], 0, globals, MONITOR_N_GLOBALS)) { cleanup(handles, handle_count); }
+
+    if (run_monitor(handles, handle_count, session->monitor_task) || rc_abort_requested) {
+        return;
+    }
+
+    // The program hash only says what we last loaded on the task. If something else loaded
+    // another program there since, the task is not running our monitor: load it again.
+    rc_message("safety monitor did not start on task %d, loading it again", (int) session->monitor_task);
+    if(!SoloistProgramStop(handles[0], session->monitor_task)) { cleanup(handles, handle_count); }
+    DWORD hash_index = PROGRAM_HASH + (session->monitor_task - TASKID_01);
+    DOUBLE unknown = 0;
+    if(!SoloistVariableSetGlobalDoubles(handles[0], hash_index, &unknown, 1)) { cleanup(handles, handle_count); }
+    char monitor_suffix[] = "\\safety_monitor.ab";
+    load_program(handles, handle_count, session->monitor_task, ab_directory, monitor_suffix);
+
+    // Never go into gear without it.
+    if (!run_monitor(handles, handle_count, session->monitor_task) && !rc_abort_requested) {
+        rc_message("safety monitor did not start on task %d", (int) session->monitor_task);
+        cleanup(handles, handle_count);
+    }
+}
+
+
+
+static int
+read_monitor(SoloistHandle *handles, DWORD handle_count)
+{
+    DOUBLE exit_reason;
+
+    if(!TIMED(TELEMETRY_GET_GLOBAL_DOUBLES, SoloistVariableGetGlobalDoubles(handles[0], MONITOR_EXIT, &exit_reason, 1))) { cleanup(handles, handle_count); }
+    return (int) exit_reason;
+}
+
+
+
+static int
+monitor_done(SoloistHandle *handles, DWORD handle_count, void *exit_reason)
+{
+    *(int *) exit_reason = read_monitor(handles, handle_count);
+    if (*(int *) exit_reason != MONITOR_RUNNING) return 1;
+
+    // The monitor looks after the stage meanwhile, so the wait can be spared.
+    if (rc_session_idle != NULL) rc_session_idle();
+    return 0;
+}
+
+
+
+static int
+wait_for_monitor(SoloistHandle *handles, DWORD handle_count, RcSession *session)
+{
+    // The monitor takes the stage out of gear by itself, we only wait for it to say why.
+    int exit_reason = MONITOR_RUNNING;
+    if (!wait_until(handles, handle_count, monitor_done, &exit_reason, WAIT_LATENCY_US)) {
+        return RC_ABORTED;
+    }
+    telemetry_exit_seen();
+
+    // Let the program finish before the task is used again
+    wait_for_task(handles, handle_count, session->monitor_task, WAIT_LATENCY_US);
+
+    switch (exit_reason) {
+        case MONITOR_LIMIT:
+            return RC_SUCCESS;
+        case MONITOR_FAULT:
+        case MONITOR_SPEED:
+            return RC_FAILED;
+        default:
+            // MONITOR_STOPPED: stop_monitor() was called, by abort.exe or the daemon.
+            return RC_ABORTED;
+    }
+}
+
+
+
+static int
+report_telemetry(SoloistHandle *handles, DWORD handle_count, int result)
+{
+    // Add the monitor's own time from the limit to out of gear, unless we were told to
+    // leave the controller alone. Returns result.
+    if (result != RC_ABORTED) {
+        DOUBLE reaction_us;
+        if(!SoloistVariableGetGlobalDoubles(handles[0], MONITOR_REACTION_US, &reaction_us, 1)) { cleanup(handles, handle_count); }
+        telemetry_monitor_reaction(reaction_us);
+    }
+    telemetry_end(result);
+    return result;
+}
+
+
+
+static void
+setup_gear_session(SoloistHandle *handles, DWORD handle_count, DOUBLE ai_offset, DOUBLE gear_scale, DOUBLE deadband)
+{
+    // Analog output velocity tracking was set up by rc_prepare_session().
+
+    // Setup pso output
+    if(!SoloistPSOControl(handles[0], PSOMODE_Reset)) { cleanup(handles, handle_count); }
+    if(!SoloistPSOPulseCyclesAndDelay(handles[0], 1000000, 500000, 1, 0)) { cleanup(handles, handle_count); }
+    if(!SoloistPSOOutputPulse(handles[0])) { cleanup(handles, handle_count); }
+
+    // Set the gearing parameters...
+    int gear_set = set_gear_params(handles, GEARCAM_SOURCE, gear_scale, deadband, 0);
+    if (gear_set != 0) { cleanup(handles, handle_count); }
+
+    // Enable
+    if(!SoloistMotionEnable(handles[0])) { cleanup(handles, handle_count); }
+
+    // Subtract offset on analog input
+    if(!SoloistParameterSetValue(handles[0], PARAMETERID_Analog0InputOffset, 1, ai_offset)) { cleanup(handles, handle_count); }
+}
+
+
+
+static void
+end_gear_session(SoloistHandle *handles, DWORD handle_count)
+{
+    // Pulse the digital output
+    if(!SoloistPSOControl(handles[0], PSOMODE_Fire)) { cleanup(handles, handle_count); }
+
+    // Reset the gear parameters to their defaults.
+    reset_gear(handles, handle_count);
+}
+
+
+
+void
+rc_default_ramp(RcRamp *ramp)
+{
+    ramp->up_us = RAMP_UP_US;
+    ramp->down_us = RAMP_DOWN_US;
+    ramp->shape = RAMP_LINEAR;
+    for (int i = 0; i < RAMP_TABLE_POINTS; i++) {
+        ramp->table[i] = (DOUBLE) i / (RAMP_TABLE_POINTS - 1);
+    }
+}
+
+
+
+int
+rc_parse_ramp(int argc, char **argv, RcRamp *ramp)
+{
+    // Optional ramp arguments of the gear executables and daemon commands:
+    //     [up_us down_us [linear|cosine|s_curve|table v0 v1 ... vn]]
+    // A table is the fraction of the ramp (0 to 1) at evenly spaced times, and is
+    // resampled to RAMP_TABLE_POINTS. Returns 0, or -1 if the arguments are not valid.
+    rc_default_ramp(ramp);
+
+    if (argc >= 1) ramp->up_us = atof(argv[0]);
+    if (argc >= 2) ramp->down_us = atof(argv[1]);
+    if (ramp->up_us < 0 || ramp->down_us < 0) {
+        return -1;
+    }
+    if (argc < 3) {
+        return 0;
+    }
+
+    if (strcmp(argv[2], "linear") == 0) {
+        ramp->shape = RAMP_LINEAR;
+    } else if (strcmp(argv[2], "cosine") == 0) {
+        ramp->shape = RAMP_COSINE;
+    } else if (strcmp(argv[2], "s_curve") == 0) {
+        ramp->shape = RAMP_S_CURVE;
+    } else if (strcmp(argv[2], "table") == 0) {
+        ramp->shape = RAMP_TABLED;
+    } else {
+        return -1;
+    }
+
+    if (ramp->shape != RAMP_TABLED) {
+        return 0;
+    }
+
+    int n = argc - 3;
+    if (n < 2) {
+        return -1;
+    }
+    for (int i = 0; i < RAMP_TABLE_POINTS; i++) {
+        DOUBLE x = (DOUBLE) i * (n - 1) / (RAMP_TABLE_POINTS - 1);
+        int j = (int) x;
+        if (j >= n - 1) j = n - 2;
+        DOUBLE v0 = atof(argv[3 + j]);
+        DOUBLE v1 = atof(argv[4 + j]);
+        ramp->table[i] = v0 + (x - j) * (v1 - v0);
+    }
+    return 0;
+}
+
+
+
+void
+rc_prepare_session(SoloistHandle *handles, DWORD handle_count, int op, char *ab_directory, RcSession *session)
+{
+    // Everything a gear session needs which does not disturb a session still running:
+    // its programs are loaded into the other pair of tasks and the analog output is set up.
+    // The gear parameters and the analog input offset are axis parameters, so those are
+    // only written when the session starts.
+
+    // A session prepared again keeps its tasks.
+    if (session->op == RC_OP_NONE) {
+        LONG pair = InterlockedIncrement(&n_sessions) & 1;
+        session->ramp_task = ramp_tasks[pair];
+        session->monitor_task = monitor_tasks[pair];
+    }
+
+    // Path to the aerobasic script which will control ramping up of the gain.
+    // The monitor ramps the gain down at the limits.
+    if (op == RC_OP_LISTEN_UNTIL || op == RC_OP_MISMATCH_RAMP_UP_UNTIL) {
+        char suffix[] = "\\ramp_gain.ab";
+        load_program(handles, handle_count, session->ramp_task, ab_directory, suffix);
+    }
+
+    // The aerobasic script which checks the limits while in gear
+    char monitor_suffix[] = "\\safety_monitor.ab";
+    load_program(handles, handle_count, session->monitor_task, ab_directory, monitor_suffix);
+
+    // Setup analog output velocity tracking
+    if(!SoloistAdvancedAnalogTrack(handles[0], AO_CHANNEL, AO_SERVO_VALUE, AO_SCALE_FACTOR, 0.0)){ cleanup(handles, handle_count); }
+
+    session->op = op;
+}
+
+
+
+void
+rc_home(SoloistHandle *handles, DWORD handle_count)
+{
+    // Reset just in case
+    reset_gear(handles, handle_count);
+
+    // Enable axis
+    if(!SoloistMotionEnable(handles[0])) { cleanup(handles, handle_count); }
+
+    // Home the axis
+    if(!SoloistMotionHomeConditional(handles[0])) { cleanup(handles, handle_count); }
+
+    // Disable the axis
+    if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
+}
+
+
+
+void
+rc_reset(SoloistHandle *handles, DWORD handle_count)
+{
+    // Reset gear parameters
+    reset_gear(handles, handle_count);
+
+    // Enable
+    if(!SoloistMotionEnable(handles[0])) { cleanup(handles, handle_count); }
+
+    // Move to the default position at the default speed
+    if(!SoloistMotionSetupRampRateAccel(handles[0], DEFAULT_RAMPRATE)) { cleanup(handles, handle_count); }
+    if(!SoloistMotionSetupRampMode(handles[0], DEFAULT_RAMPMODE)) { cleanup(handles, handle_count); }
+    if(!SoloistMotionMoveAbs(handles[0], DEFAULT_POSITION, DEFAULT_SPEED)) { cleanup(handles, handle_count); }
+
+    // Make sure controller waits for move to finish
+    if(!SoloistMotionWaitForMotionDone(handles[0], WAITOPTION_MoveDone, 50000, NULL)) { cleanup(handles, handle_count); }
+
+    // Disable
+    if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
+}
+
+
+
+void
+rc_move_to(SoloistHandle *handles, DWORD handle_count, DOUBLE position, DOUBLE speed, int leave_enabled)
+{
+    BOOL time_out;
+
+    // Setup analog output velocity tracking
+    if(!SoloistAdvancedAnalogTrack(handles[0], AO_CHANNEL, AO_SERVO_VALUE, AO_SCALE_FACTOR, 0.0)){ cleanup(handles, handle_count); }
+
+    // Reset gear parameters
+    reset_gear(handles, handle_count);
+
+    // Enable axis
+    if(!SoloistMotionEnable(handles[0])) { cleanup(handles, handle_count); }
+
+    // Move to the position at the requested speed
+    if(!SoloistMotionSetupRampRateAccel(handles[0], DEFAULT_RAMPRATE)) { cleanup(handles, handle_count); }
+    if(!SoloistMotionSetupRampMode(handles[0], DEFAULT_RAMPMODE)) { cleanup(handles, handle_count); }
+    if(!SoloistMotionMoveAbs(handles[0], position, speed)) { cleanup(handles, handle_count); }
+
+    // Make sure controller waits for move to finish
+    if(!SoloistMotionWaitForMotionDone(handles[0], WAITOPTION_MoveDone, 50000, &time_out)) { cleanup(handles, handle_count); }
+
+    // If we have requested, stay enabled.
+    if (!leave_enabled) {
+        if(!SoloistMotionDisable(handles[0])) { cleanup(handles, handle_count); }
+    }
+}
+
+
+
+DOUBLE
+rc_calibrate_zero(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                  DOUBLE ai_offset, int leave_enabled, char *ab_directory, RcSession *prepared)
+{
+    // Setup iteration to record the analog input.
+    int iter = 0;
+    DOUBLE ai_value[CALIBRATE_N_ITER];
+
+    telemetry_begin("calibrate_zero");
+
+    RcSession local;
+    RcSession *session = use_session(handles, handle_count, RC_OP_CALIBRATE_ZERO, ab_directory, prepared, &local);
+
+    // Set the gearing parameters...
+    int gear_set = set_gear_params(handles, GEARCAM_SOURCE, 0, 0, 0);
+    if (gear_set != 0) { cleanup(handles, handle_count); }
+
+    // Enable
+    if(!SoloistMotionEnable(handles[0])) { cleanup(handles, handle_count); }
+
+    // Subtract offset on analog input
+    if(!SoloistParameterSetValue(handles[0], PARAMETERID_Analog0InputOffset, 1, ai_offset)) { cleanup(handles, handle_count); }
+
+    // The monitor checks the limits while we are in gear.
+    start_monitor(handles, handle_count, session, ab_directory, backward_limit, forward_limit, 0);
+
+    // Set to gear mode... no turning back now.
+    if(!TIMED(TELEMETRY_COMMAND_EXECUTE, SoloistCommandExecute(handles[0], "GEAR 1", NULL))) { cleanup(handles, handle_count); }
+
+    // Record the analog input level until CALIBRATE_N_ITER samples, or the monitor would stop.
+    // One status read gives the sample, the fault and the velocity the monitor checks. The
+    // position limits are left to the monitor, so that they are checked against the same
+    // position (DRIVEINFO(94)) as in the gear sessions; we stop once it has exited.
+    RcStatus status;
+    telemetry_wait_start();
+    while (iter < CALIBRATE_N_ITER && !rc_abort_requested) {
+        telemetry_poll();
+        read_status(handles, handle_count, &status);
+        if (status.fault > 0.5 || fabs(status.velocity) > SPEED_LIMIT ||
+                read_monitor(handles, handle_count) != MONITOR_RUNNING) {
+            break;
+        }
+        ai_value[iter++] = status.analog_input;
+    }
+    telemetry_wait_end();
+
+    // The daemon has already disabled the axis and reset the gear on abort.
+    if (rc_abort_requested) {
+        telemetry_end(RC_ABORTED);
+        return 0;
+    }
+
+    // Ask the monitor to take the stage out of gear, and wait for it.
+    stop_monitor(handles, handle_count);
+    wait_for_task(handles, handle_count, session->monitor_task, WAIT_LATENCY_US);
+
+    // If we have requested, stay enabled.
+    if (!leave_enabled) {
+        if(!TIMED(TELEMETRY_MOTION_DISABLE, SoloistMotionDisable(handles[0]))) { cleanup(handles, handle_count); }
+    }
+
+    // Reset the gear parameters to their defaults.
+    reset_gear(handles, handle_count);
+
+    // Calculate the average analog offset.
+    DOUBLE sum = 0;
+    for (int i = 0; i < iter; i++) {
+        sum += ai_value[i];
+    }
+    telemetry_end(RC_SUCCESS);
+    return (iter > 0) ? sum/iter : 0;
+}
+
+
+
+int
+rc_listen_until(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                DOUBLE ai_offset, DOUBLE gear_scale, DOUBLE deadband, DWORD wait_for_trigger_input, char *ab_directory,
+                const RcRamp *ramp, const RcCollect *collect, RcSession *prepared)
+{
+    telemetry_begin("listen_until");
+
+    // Load the ramp up aerobasic script and the monitor, unless they are already loaded
+    RcSession local;
+    RcSession *session = use_session(handles, handle_count, RC_OP_LISTEN_UNTIL, ab_directory, prepared, &local);
+
+    // The ramp program waits for nothing, we wait for the trigger here if asked to.
+    start_ramps(handles, handle_count, ramp, 0, gear_scale, 0);
+    setup_gear_session(handles, handle_count, ai_offset, 0, deadband);
+
+    // Wait for a trigger to go low.
+    if (wait_for_trigger_input == 1) {
+        wait_for_trigger(handles, handle_count);
+    }
+
+    int result = RC_ABORTED;
+    if (!rc_abort_requested) {
+
+        // Sample the stage on the controller while in gear, if asked to.
+        collect_start(handles, handle_count, collect);
+
+        // The monitor checks the limits from before we go into gear.
+        start_monitor(handles, handle_count, session, ab_directory, backward_limit, forward_limit, 1);
+
+        // Set to gear mode... no turning back now.
+        if(!TIMED(TELEMETRY_COMMAND_EXECUTE, SoloistCommandExecute(handles[0], "GEAR 1", NULL))) { cleanup(handles, handle_count); }
+
+        // Start the aerobasic script and wait for it to finish
+        if(!TIMED(TELEMETRY_PROGRAM_START, SoloistProgramStart(handles[0], session->ramp_task))) { cleanup(handles, handle_count); }
+        wait_for_task(handles, handle_count, session->ramp_task, WAIT_LATENCY_US);
+
+        result = wait_for_monitor(handles, handle_count, session);
+    }
+
+    // The samples up to here, including the ramp down and any abort, are written out.
+    collect_stop(handles, handle_count);
+
+    // A monitor stopped from outside (abort.exe abort or stop) is an abort too, the
+    // controller is left to whoever stopped it.
+    if (!rc_abort_requested && result != RC_ABORTED) {
+
+        // Disable the axis.
+        if(!TIMED(TELEMETRY_MOTION_DISABLE, SoloistMotionDisable(handles[0]))) { cleanup(handles, handle_count); }
+        telemetry_disabled();
+
+        end_gear_session(handles, handle_count);
+    } else {
+        result = RC_ABORTED;
+    }
+
+    return report_telemetry(handles, handle_count, result);
+}
+
+
+
+int
+rc_mismatch_ramp_up_until(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                          DOUBLE ai_offset, DOUBLE gear_scale, DOUBLE deadband, char *ab_directory,
+                          const RcRamp *ramp, const RcCollect *collect, RcSession *prepared)
+{
+    telemetry_begin("mismatch_ramp_up_until");
+
+    // Load the ramp up aerobasic script and the monitor, unless they are already loaded
+    RcSession local;
+    RcSession *session = use_session(handles, handle_count, RC_OP_MISMATCH_RAMP_UP_UNTIL, ab_directory, prepared, &local);
+
+    // The ramp program also waits for the digital input before ramping up.
+    start_ramps(handles, handle_count, ramp, 0, gear_scale, 1);
+    setup_gear_session(handles, handle_count, ai_offset, 0, deadband);
+
+    // Wait for a trigger to go low.
+    wait_for_trigger(handles, handle_count);
+
+    int result = RC_ABORTED;
+    if (!rc_abort_requested) {
+
+        collect_start(handles, handle_count, collect);
+
+        // The monitor checks the limits from before we go into gear, and stops at them without a ramp.
+        start_monitor(handles, handle_count, session, ab_directory, backward_limit, forward_limit, 0);
+
+        // Set to gear mode... no turning back now.
+        if(!TIMED(TELEMETRY_COMMAND_EXECUTE, SoloistCommandExecute(handles[0], "GEAR 1", NULL))) { cleanup(handles, handle_count); }
+
+        // Start the aerobasic script and wait for it to finish
+        if(!TIMED(TELEMETRY_PROGRAM_START, SoloistProgramStart(handles[0], session->ramp_task))) { cleanup(handles, handle_count); }
+        wait_for_task(handles, handle_count, session->ramp_task, WAIT_LATENCY_US);
+
+        result = wait_for_monitor(handles, handle_count, session);
+    }
+
+    // The samples up to here, including the ramp down and any abort, are written out.
+    collect_stop(handles, handle_count);
+
+    // A monitor stopped from outside (abort.exe abort or stop) is an abort too, the
+    // controller is left to whoever stopped it.
+    if (!rc_abort_requested && result != RC_ABORTED) {
+
+        // Disable the axis.
+        if(!TIMED(TELEMETRY_MOTION_DISABLE, SoloistMotionDisable(handles[0]))) { cleanup(handles, handle_count); }
+        telemetry_disabled();
+
+        end_gear_session(handles, handle_count);
+    } else {
+        result = RC_ABORTED;
+    }
+
+    return report_telemetry(handles, handle_count, result);
+}
+
+
+
+int
+rc_mismatch_ramp_down_at(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                         DOUBLE ai_offset, DOUBLE gear_scale, DOUBLE deadband, char *ab_directory,
+                         const RcRamp *ramp, const RcCollect *collect, RcSession *prepared)
+{
+    telemetry_begin("mismatch_ramp_down_at");
+
+    // The monitor ramps the gain down when the limits are reached.
+    RcSession local;
+    RcSession *session = use_session(handles, handle_count, RC_OP_MISMATCH_RAMP_DOWN_AT, ab_directory, prepared, &local);
+
+    start_ramps(handles, handle_count, ramp, gear_scale, gear_scale, 0);
+    setup_gear_session(handles, handle_count, ai_offset, gear_scale, deadband);
+
+    // Wait for a trigger to go low.
+    wait_for_trigger(handles, handle_count);
+
+    int result = RC_ABORTED;
+    if (!rc_abort_requested) {
+
+        collect_start(handles, handle_count, collect);
+
+        start_monitor(handles, handle_count, session, ab_directory, backward_limit, forward_limit, 1);
+
+        // Set to gear mode... no turning back now.
+        if(!TIMED(TELEMETRY_COMMAND_EXECUTE, SoloistCommandExecute(handles[0], "GEAR 1", NULL))) { cleanup(handles, handle_count); }
+
+        result = wait_for_monitor(handles, handle_count, session);
+    }
+
+    // The samples up to here, including the ramp down and any abort, are written out.
+    collect_stop(handles, handle_count);
+
+    // A monitor stopped from outside (abort.exe abort or stop) is an abort too, the
+    // controller is left to whoever stopped it.
+    if (!rc_abort_requested && result != RC_ABORTED) {
+
+        // Disable the axis.
+        if(!TIMED(TELEMETRY_MOTION_DISABLE, SoloistMotionDisable(handles[0]))) { cleanup(handles, handle_count); }
+        telemetry_disabled();
+
+        end_gear_session(handles, handle_count);
+    } else {
+        result = RC_ABORTED;
+    }
+
+    return report_telemetry(handles, handle_count, result);
+}
@@ -1,20 +1,65 @@
+// CreateWaitableTimerExW (wait_until) is only declared for Windows Vista and later
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+
+#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include <tchar.h>
 #include "rc_soloist.h"
 
+// Windows 10 1803 and later, missing from older headers
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+
+
+volatile LONG rc_abort_requested = 0;
+void (*rc_session_idle)(void) = NULL;
+void (*rc_output)(const char *line) = NULL;
+
 
 
 void cleanup(SoloistHandle *handles, DWORD handle_count);
 int set_gear_params(SoloistHandle *handles, DOUBLE src, DOUBLE gear_scale, DOUBLE deadband, DOUBLE k_pos);
 void print_error();
 void reset_gear(SoloistHandle *handles, DWORD handle_count);
+void forget_programs(SoloistHandle *handles, DWORD handle_count);
+void stop_monitor(SoloistHandle *handles, DWORD handle_count);
+void read_status(SoloistHandle *handles, DWORD handle_count, RcStatus *status);
+int wait_until(SoloistHandle *handles, DWORD handle_count, RcCondition condition, void *data, DWORD latency_us);
+int task_complete(SoloistHandle *handles, DWORD handle_count, void *task);
+int wait_for_task(SoloistHandle *handles, DWORD handle_count, TASKID task, DWORD latency_us);
+DWORD hash_program(char *ab_path);
+
+void
+rc_message(const char *format, ...)
+{
+    // A line for the user, through rc_output if set, otherwise on stderr, as stdout is
+    // the result of the executables.
+    char line[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (rc_output != NULL) {
+        rc_output(line);
+        return;
+    }
+    fprintf(stderr, "%s\n", line);
+    fflush(stderr);
+}
+
 
 void
 print_error()
 {
     CHAR data[1024];
     SoloistGetLastErrorString(data, 1024);
-    printf("Error : %s\n", data);
+    rc_message("Error : %s", data);
 }
 
 
@@ -26,6 +71,7 @@ cleanup(SoloistHandle *handles, DWORD handle_count)
     if(handle_count > 0) {
 		if(!SoloistMotionDisable(handles[0])) { print_error(); }
         reset_gear(handles, handle_count);
+        forget_programs(handles, handle_count);
 		if(!SoloistDisconnect(handles)) { print_error(); }
     }
     exit(-1);
@@ -55,6 +101,126 @@ reset_gear(SoloistHandle *handles, DWORD handle_count) {
 }
 
 
+
+void
+forget_programs(SoloistHandle *handles, DWORD handle_count) {
+
+    // Set the hashes of the programs on tasks 1 to 4 to unknown, so that the next
+    // gear session loads its programs again. Anything which loads other programs on
+    // these tasks must call this, load_program() only trusts the hashes. Errors are
+    // only printed, as this is also used by cleanup().
+    DOUBLE unknown[PROGRAM_N_TASKS] = {0};
+    if(!SoloistVariableSetGlobalDoubles(handles[0], PROGRAM_HASH, unknown, PROGRAM_N_TASKS)) { print_error(); }
+}
+
+
+void
+stop_monitor(SoloistHandle *handles, DWORD handle_count) {
+    
+    // Ask safety_monitor.ab to take the stage out of gear and finish, if it is running
+    DOUBLE stop = 1;
+    if(!SoloistVariableSetGlobalDoubles(handles[0], MONITOR_STOP, &stop, 1)) { cleanup(handles, handle_count); }
+}
+
+
+void
+read_status(SoloistHandle *handles, DWORD handle_count, RcStatus *status) {
+    
+    // Read all the items in one call, rather than one SoloistCommandExecute each
+    // The position limits are checked by safety_monitor.ab on the controller, not here.
+    STATUSITEM items[] = {STATUSITEM_AxisFault, STATUSITEM_VelocityFeedback,
+                          STATUSITEM_DigitalInput, STATUSITEM_AnalogInput0};
+    DWORD extras[] = {0, 0, DI_PORT, 0};
+    DOUBLE values[4];
+    
+    if(!TIMED(TELEMETRY_STATUS_GET_ITEMS, SoloistStatusGetItems(handles[0], 4, items, extras, values))) { cleanup(handles, handle_count); }
+    
+    status->fault = values[0];
+    status->velocity = values[1];
+    status->digital_input = (DWORD) values[2];
+    status->analog_input = values[3];
+}
+
+
+static void
+sleep_us(HANDLE timer, DWORD us) {
+    
+    // Sleep for about us, or at least 1 ms without a high resolution timer.
+    if (timer != NULL) {
+        LARGE_INTEGER due;
+        due.QuadPart = -10 * (LONGLONG) us;    // relative, in 100 ns
+        if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+    Sleep((us < 1000) ? 1 : us / 1000);
+}
+
+
+int
+wait_until(SoloistHandle *handles, DWORD handle_count, RcCondition condition, void *data, DWORD latency_us) {
+    
+    // Poll continuously at first, as most waits are short. Then yield the core between polls,
+    // and finally sleep so that a condition is still noticed within about latency_us.
+    // Returns 1 once the condition holds, 0 if an abort was requested first.
+    LARGE_INTEGER frequency, start, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    
+    // Sleep() has the resolution of the system timer, 15.6 ms unless we ask for better.
+    // A high resolution waitable timer also sleeps for less than 1 ms, for the short
+    // latency targets (e.g. the trigger), where it is available.
+    timeBeginPeriod(1);
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    
+    int result = 0;
+    telemetry_wait_start();
+    while (!rc_abort_requested) {
+        
+        telemetry_poll();
+        if (condition(handles, handle_count, data)) {
+            result = 1;
+            break;
+        }
+        collect_poll(handles, handle_count);
+        
+        QueryPerformanceCounter(&now);
+        LONGLONG elapsed_us = 1000000 * (now.QuadPart - start.QuadPart) / frequency.QuadPart;
+        
+        if (elapsed_us < WAIT_SPIN_US) {
+            continue;
+        } else if (elapsed_us < WAIT_YIELD_US) {
+            SwitchToThread();
+        } else {
+            sleep_us(timer, latency_us);
+        }
+    }
+    
+    telemetry_wait_end();
+    if (timer != NULL) CloseHandle(timer);
+    timeEndPeriod(1);
+    return result;
+}
+
+
+int
+task_complete(SoloistHandle *handles, DWORD handle_count, void *task) {
+    
+    TASKSTATE task_state;
+    if(!TIMED(TELEMETRY_PROGRAM_GET_TASK_STATE, SoloistProgramGetTaskState(handles[0], *(TASKID *) task, &task_state))) { cleanup(handles, handle_count); }
+    return task_state == TASKSTATE_ProgramComplete;
+}
+
+
+int
+wait_for_task(SoloistHandle *handles, DWORD handle_count, TASKID task, DWORD latency_us) {
+    
+    // Wait for the program on the task to finish
+    return wait_until(handles, handle_count, task_complete, &task, latency_us);
+}
+
+
 char *
 get_ab_path(char *ab_dir, char *suffix) {
 // return paths to the aerobasic scripts
@@ -64,4 +230,72 @@ get_ab_path(char *ab_dir, char *suffix) {
 	full_path = (char *) realloc(full_path, strlen(full_path) + strlen(suffix) + 1);
 	strcat(full_path, suffix);
 	return full_path;
-}
\ No newline at end of file
+}
+
+
+
+// 32-bit FNV-1a, so that a hash fits exactly in a DGLOBAL
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+// Includes are followed this deep, in case of a cycle
+#define MAX_INCLUDE_DEPTH   8
+
+
+static DWORD
+hash_bytes(DWORD hash, const char *data, size_t n) {
+    
+    for (size_t i = 0; i < n; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+
+static DWORD
+hash_file(DWORD hash, const char *path, int depth) {
+    
+    // Hash the file, and each file it includes from the same directory.
+    // Includes which are not found there (AeroBasicInclude.abi) only count by name.
+    char line[1024];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return hash_bytes(hash, path, strlen(path));
+    }
+    
+    while (fgets(line, sizeof(line), f) != NULL) {
+        hash = hash_bytes(hash, line, strlen(line));
+        
+        char *c = line;
+        while (*c == ' ' || *c == '\t') c++;
+        if (depth >= MAX_INCLUDE_DEPTH || _strnicmp(c, "INCLUDE", 7) != 0) continue;
+        
+        char *name = strchr(c + 7, '"');
+        char *end = (name != NULL) ? strchr(name + 1, '"') : NULL;
+        if (end == NULL) continue;
+        name++;
+        
+        // Path of the include, relative to the including file
+        size_t dir_len = strlen(path);
+        while (dir_len > 0 && path[dir_len - 1] != '\\' && path[dir_len - 1] != '/') dir_len--;
+        char *include_path = (char *) malloc(dir_len + (end - name) + 1);
+        memcpy(include_path, path, dir_len);
+        memcpy(include_path + dir_len, name, end - name);
+        include_path[dir_len + (end - name)] = '\0';
+        
+        hash = hash_file(hash, include_path, depth + 1);
+        free(include_path);
+    }
+    
+    fclose(f);
+    return hash;
+}
+
+
+DWORD
+hash_program(char *ab_path) {
+    
+    // Hash of an aerobasic program and its includes. Never 0, which marks an unknown program.
+    DWORD hash = hash_file(FNV_OFFSET_BASIS, ab_path, 0);
+    return (hash == 0) ? 1 : hash;
+}
@@ -4,11 +4,233 @@
 #include "C:\Program Files (x86)\Aerotech\Soloist\CLibrary\Include\Soloist.h"
 #include "options.h"
 
+// Defaults for options added after options.h was set up on a rig
+#ifndef WAIT_LATENCY_US
+#define WAIT_LATENCY_US                 5000
+#endif
+#ifndef WAIT_TRIGGER_LATENCY_US
+#define WAIT_TRIGGER_LATENCY_US         500
+#endif
+#ifndef WAIT_SPIN_US
+#define WAIT_SPIN_US                    1000
+#endif
+#ifndef WAIT_YIELD_US
+#define WAIT_YIELD_US                   10000
+#endif
+#ifndef RAMP_UP_US
+#define RAMP_UP_US                      200000
+#endif
+#ifndef RAMP_DOWN_US
+#define RAMP_DOWN_US                    500000
+#endif
+#ifndef TELEMETRY_PATH
+#define TELEMETRY_PATH                  ""
+#endif
+#ifndef MONITOR_START_MS
+#define MONITOR_START_MS                10
+#endif
+#ifndef COLLECT_RATE_HZ
+#define COLLECT_RATE_HZ                 1000
+#endif
+#ifndef COLLECT_MAX_SAMPLES
+#define COLLECT_MAX_SAMPLES             2400000
+#endif
+#ifndef COLLECT_DRAIN_MS
+#define COLLECT_DRAIN_MS                50
+#endif
+
+// Axis state read in one round trip by read_status()
+typedef struct {
+    DOUBLE fault;                       // AXISFAULT, non-zero on a fault
+    DOUBLE velocity;                    // velocity feedback (user units/s)
+    DWORD digital_input;                // state of DI_PORT
+    DOUBLE analog_input;                // analog input AI_CHANNEL (V)
+} RcStatus;
+
+// Condition polled by wait_until(), returns non-zero when the wait is over
+typedef int (*RcCondition)(SoloistHandle *handles, DWORD handle_count, void *data);
+
 // Common functions in rc_shared.c
 void cleanup(SoloistHandle *handles, DWORD handle_count);
 int set_gear_params(SoloistHandle *handles, DOUBLE src, 
 				DOUBLE gear_scale, DOUBLE deadband, DOUBLE k_pos);
 void reset_gear(SoloistHandle *handles, DWORD handle_count);
+void forget_programs(SoloistHandle *handles, DWORD handle_count);
 char *get_ab_path(char *ab_dir, char *suffix);
+DWORD hash_program(char *ab_path);
+void stop_monitor(SoloistHandle *handles, DWORD handle_count);
+void read_status(SoloistHandle *handles, DWORD handle_count, RcStatus *status);
+int wait_until(SoloistHandle *handles, DWORD handle_count, RcCondition condition, void *data, DWORD latency_us);
+int task_complete(SoloistHandle *handles, DWORD handle_count, void *task);
+int wait_for_task(SoloistHandle *handles, DWORD handle_count, TASKID task, DWORD latency_us);
+
+// Results of the gear sessions
+#define RC_ABORTED                      -1      // abort requested by the host
+#define RC_FAILED                       0       // stopped on an axis fault or the speed limit
+#define RC_SUCCESS                      1       // reached a position limit
+
+// DGLOBAL variables shared with safety_monitor.ab (see rc_globals.abi)
+#define MONITOR_BACKWARD_LIMIT          0
+#define MONITOR_FORWARD_LIMIT           1
+#define MONITOR_SPEED_LIMIT             2
+#define MONITOR_RAMP_DOWN               3       // ramp the gain down at the position limits
+#define MONITOR_STOP                    4       // set by the host to end the monitor
+#define MONITOR_EXIT                    5       // exit reason, written by the monitor
+#define MONITOR_N_GLOBALS               6
+#define MONITOR_REACTION_US             14      // limit, fault or stop to out of gear, written by the monitor
+#define MONITOR_STATE                   15      // cleared by the host, set by the monitor (also once it has started)
+
+// DGLOBAL variables read by ramp_gain.ab, and by safety_monitor.ab when it ramps down
+#define RAMP_FROM                       6
+#define RAMP_TO                         7
+#define RAMP_OVER_US                    8
+#define RAMP_WAIT_TRIGGER               9       // wait for the digital input before ramping
+#define RAMP_DOWN_OVER_US               11
+#define RAMP_SHAPE                      12
+#define RAMP_SCALE                      13      // current gear scale factor, written by the programs
+#define RAMP_TABLE                      16      // fraction of the ramp at evenly spaced times
+#define RAMP_TABLE_POINTS               16
+#define RAMP_N_GLOBALS                  (RAMP_TABLE + RAMP_TABLE_POINTS - RAMP_FROM)
+
+// DGLOBAL variables written only by the host: hash_program() of the program
+// loaded on each task (TASKID_01 to TASKID_04), 0 if unknown. Anything else
+// loading a program on these tasks must clear them with forget_programs()
+#define PROGRAM_HASH                    32
+#define PROGRAM_N_TASKS                 4
+
+// Values of MONITOR_EXIT
+#define MONITOR_RUNNING                 0
+#define MONITOR_LIMIT                   1
+#define MONITOR_FAULT                   2
+#define MONITOR_SPEED                   3
+#define MONITOR_STOPPED                 4
+
+// Values of MONITOR_STATE. Once tripped ramp_gain.ab leaves the gain to the monitor.
+#define MONITOR_NOT_STARTED             0
+#define MONITOR_WATCHING                1
+#define MONITOR_TRIPPED                 2
+
+// Values of RAMP_SHAPE
+#define RAMP_LINEAR                     0
+#define RAMP_COSINE                     1
+#define RAMP_S_CURVE                    2
+#define RAMP_TABLED                     3
+
+// Number of analog input samples averaged by rc_calibrate_zero
+#define CALIBRATE_N_ITER                50
+
+// Ramps of the gear scale factor, written to the controller by each gear session
+typedef struct {
+    DOUBLE up_us;                       // duration of the ramp up
+    DOUBLE down_us;                     // duration of the ramp down at the limits
+    int shape;                          // RAMP_*
+    DOUBLE table[RAMP_TABLE_POINTS];    // for RAMP_TABLED, fraction of the ramp from 0 to 1
+} RcRamp;
+
+// Data collection during the gear sessions, in rc_collect.c
+#define COLLECT_MAGIC                   "RCSOLDC"
+#define COLLECT_VERSION                 1
+#define COLLECT_N_CHANNELS              5
+#define COLLECT_NAME_LENGTH             32
+#define COLLECT_MAX_RATE_HZ             20000
+#define COLLECT_BLOCK_SAMPLES           1000    // samples retrieved from the controller at a time
+
+typedef struct {
+    char *path;                         // file to write, NULL for no data collection
+    DOUBLE rate_hz;
+} RcCollect;
+
+// Start of a data collection file, followed by float32 samples
+typedef struct {
+    char magic[8];                      // COLLECT_MAGIC
+    DWORD version;                      // COLLECT_VERSION
+    DWORD n_channels;
+    DOUBLE rate_hz;
+    FILETIME start_time;                // when sampling started (UTC)
+    char channel_names[COLLECT_N_CHANNELS][COLLECT_NAME_LENGTH];
+} RcCollectHeader;
+
+int rc_parse_collect(int argc, char **argv, RcCollect *collect);
+void collect_start(SoloistHandle *handles, DWORD handle_count, const RcCollect *collect);
+void collect_poll(SoloistHandle *handles, DWORD handle_count);
+void collect_stop(SoloistHandle *handles, DWORD handle_count);
+
+// Timing of the gear sessions, in rc_telemetry.c
+#define TELEMETRY_N_BUCKETS             24      // log2 histograms, from below 2 us to above 8 s
+#define TELEMETRY_REPORT_LENGTH         8192
+#define TELEMETRY_STATUS_GET_ITEMS      0       // Soloist calls timed with TIMED()
+#define TELEMETRY_PROGRAM_GET_TASK_STATE 1
+#define TELEMETRY_GET_GLOBAL_DOUBLES    2
+#define TELEMETRY_PROGRAM_START         3
+#define TELEMETRY_COMMAND_EXECUTE       4
+#define TELEMETRY_MOTION_DISABLE        5
+#define TELEMETRY_N_CALLS               6
+
+// Times a Soloist call for the telemetry of the session, and gives its result:
+//     if(!TIMED(TELEMETRY_MOTION_DISABLE, SoloistMotionDisable(handles[0]))) { cleanup(handles, handle_count); }
+#define TIMED(call, expr)               (telemetry_call_start = telemetry_now(), telemetry_call((call), (expr)))
+
+extern LONGLONG telemetry_call_start;
+// Called by telemetry_end() with the JSON report, instead of printing
+// "telemetry <report>" on stderr
+extern void (*telemetry_output)(const char *line);
+LONGLONG telemetry_now();
+BOOL telemetry_call(int call, BOOL ok);
+void telemetry_begin(const char *op);
+void telemetry_wait_start();
+void telemetry_poll();
+void telemetry_wait_end();
+void telemetry_exit_seen();
+void telemetry_disabled();
+void telemetry_monitor_reaction(DOUBLE us);
+void telemetry_end(int result);
+
+// Gear session operations, for rc_prepare_session()
+#define RC_OP_NONE                      0
+#define RC_OP_CALIBRATE_ZERO            1
+#define RC_OP_LISTEN_UNTIL              2
+#define RC_OP_MISMATCH_RAMP_UP_UNTIL    3
+#define RC_OP_MISMATCH_RAMP_DOWN_AT     4
+
+// Programs of a gear session, loaded by rc_prepare_session(). Set op to RC_OP_NONE before first use.
+typedef struct {
+    int op;                             // RC_OP_* the programs are loaded for
+    TASKID ramp_task;                   // task with the ramp program, if the operation has one
+    TASKID monitor_task;                // task with safety_monitor.ab
+} RcSession;
+
+// Set by the daemon when the host asks to abort. Ends every wait_until().
+extern volatile LONG rc_abort_requested;
+
+// Called by the gear sessions between polls of the monitor, on their thread, when set.
+// The daemon loads the next session's programs from it, so that only one of its threads
+// uses the controller at a time (apart from abort and stop).
+extern void (*rc_session_idle)(void);
+
+// Messages of the operations go through rc_message(), to rc_output when set (the daemon
+// replies with them, as its stdout is the reply channel), otherwise to stderr.
+extern void (*rc_output)(const char *line);
+void rc_message(const char *format, ...);
+
+// Operations in rc_commands.c, shared by the executables and the daemon.
+// The gear sessions take a session from rc_prepare_session(), or NULL to load their programs themselves,
+// a ramp, or NULL for the default, and the data to collect, or NULL for none.
+void rc_home(SoloistHandle *handles, DWORD handle_count);
+void rc_reset(SoloistHandle *handles, DWORD handle_count);
+void rc_move_to(SoloistHandle *handles, DWORD handle_count, DOUBLE position, DOUBLE speed, int leave_enabled);
+void rc_default_ramp(RcRamp *ramp);
+int rc_parse_ramp(int argc, char **argv, RcRamp *ramp);
+void rc_prepare_session(SoloistHandle *handles, DWORD handle_count, int op, char *ab_directory, RcSession *session);
+DOUBLE rc_calibrate_zero(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                DOUBLE ai_offset, int leave_enabled, char *ab_directory, RcSession *session);
+int rc_listen_until(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                DOUBLE ai_offset, DOUBLE gear_scale, DOUBLE deadband, DWORD wait_for_trigger_input, char *ab_directory,
+                const RcRamp *ramp, const RcCollect *collect, RcSession *session);
+int rc_mismatch_ramp_up_until(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                DOUBLE ai_offset, DOUBLE gear_scale, DOUBLE deadband, char *ab_directory,
+                const RcRamp *ramp, const RcCollect *collect, RcSession *session);
+int rc_mismatch_ramp_down_at(SoloistHandle *handles, DWORD handle_count, DOUBLE backward_limit, DOUBLE forward_limit,
+                DOUBLE ai_offset, DOUBLE gear_scale, DOUBLE deadband, char *ab_directory,
+                const RcRamp *ramp, const RcCollect *collect, RcSession *session);
 
 #endif /* RC_SOLOIST_H */
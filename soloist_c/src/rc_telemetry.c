@@ -0,0 +1,283 @@
+/*
+rc_telemetry.c
+Timing of the gear sessions, to follow the performance of the link to the
+controller over time. While a session runs the Soloist calls made in its poll
+loops (wrapped in TIMED()) and the iterations of wait_until() are timed with
+QueryPerformanceCounter. telemetry_end() reports one line
+
+    telemetry {"op": ..., "calls": {...}, ...}
+
+with a JSON object, and appends the object to TELEMETRY_PATH if it is set. The
+line goes to telemetry_output if set (the daemon replies with it), otherwise to
+stderr, as the executables give their result on stdout.
+
+Each histogram has TELEMETRY_N_BUCKETS counts: bucket 0 is below 2 us, bucket k
+from 2^k to 2^(k+1) us, and the last one everything longer.
+
+Nothing is recorded outside a session, from telemetry_begin() to telemetry_end().
+Only the thread running the session may use these.
+*/
+
+
+
+#include "rc_soloist.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+
+typedef struct {
+    LONGLONG count;
+    DOUBLE total_us;
+    DOUBLE max_us;
+    LONGLONG hist[TELEMETRY_N_BUCKETS];
+} RcTimes;
+
+static const char *call_names[TELEMETRY_N_CALLS] = {
+    "status_get_items",
+    "program_get_task_state",
+    "variable_get_global_doubles",
+    "program_start",
+    "command_execute",
+    "motion_disable",
+};
+
+static struct {
+    const char *op;
+    LARGE_INTEGER frequency;
+    LONGLONG start;
+    LONGLONG wait_ticks;                // time spent in wait_until()
+    LONGLONG last_poll;                 // start of the last iteration of the current wait
+    LONGLONG previous_poll;             // and of the one before
+    LONGLONG exit_bound;                // the monitor finished after this
+    RcTimes iterations;
+    RcTimes calls[TELEMETRY_N_CALLS];
+    DOUBLE monitor_reaction_us;         // limit to out of gear, measured by the monitor
+    DOUBLE exit_to_disable_us;          // monitor finished to disabled, at most
+} telemetry;
+
+LONGLONG telemetry_call_start = 0;
+void (*telemetry_output)(const char *line) = NULL;
+
+// The report is built whole, so that it is output as one line even with the daemon replying
+static char report[TELEMETRY_REPORT_LENGTH];
+static size_t report_length;
+
+
+
+static DOUBLE
+to_us(LONGLONG ticks)
+{
+    return 1e6 * (DOUBLE) ticks / telemetry.frequency.QuadPart;
+}
+
+
+
+static void
+append(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(report + report_length, sizeof(report) - report_length, format, args);
+    va_end(args);
+    if (n > 0) report_length += n;
+    if (report_length >= sizeof(report)) report_length = sizeof(report) - 1;
+}
+
+
+
+static void
+add_time(RcTimes *times, DOUBLE us)
+{
+    int bucket = 0;
+    while (bucket < TELEMETRY_N_BUCKETS - 1 && us >= (DOUBLE) (2LL << bucket)) {
+        bucket++;
+    }
+
+    times->count++;
+    times->total_us += us;
+    if (us > times->max_us) times->max_us = us;
+    times->hist[bucket]++;
+}
+
+
+
+static void
+print_times(const char *name, const RcTimes *times)
+{
+    append("\"%s\": {\"count\": %lld, \"mean_us\": %.1f, \"max_us\": %.1f, \"hist\": [",
+            name, times->count, (times->count > 0) ? times->total_us / times->count : 0.0, times->max_us);
+    for (int k = 0; k < TELEMETRY_N_BUCKETS; k++) {
+        append((k > 0) ? ", %lld" : "%lld", times->hist[k]);
+    }
+    append("]}");
+}
+
+
+
+static void
+build_report(int result)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    report_length = 0;
+    report[0] = '\0';
+    DOUBLE duration_s = to_us(now.QuadPart - telemetry.start) / 1e6;
+    DOUBLE wait_s = to_us(telemetry.wait_ticks) / 1e6;
+
+    char date[32];
+    time_t t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&t));
+
+    append("{\"op\": \"%s\", \"time\": \"%s\", \"result\": %d, \"duration_s\": %.6f, ",
+            telemetry.op, date, result, duration_s);
+    append("\"wait_s\": %.6f, \"iterations_per_s\": %.1f, ",
+            wait_s, (wait_s > 0) ? telemetry.iterations.count / wait_s : 0.0);
+    print_times("iteration", &telemetry.iterations);
+    append(", \"calls\": {");
+    for (int i = 0; i < TELEMETRY_N_CALLS; i++) {
+        if (i > 0) append(", ");
+        print_times(call_names[i], &telemetry.calls[i]);
+    }
+    append("}, ");
+
+    // Only known when the monitor stopped the session and we disabled the axis after it.
+    if (telemetry.exit_to_disable_us >= 0) {
+        append("\"monitor_reaction_us\": %.1f, \"exit_to_disable_us\": %.1f, \"limit_to_disable_us\": %.1f}",
+                telemetry.monitor_reaction_us, telemetry.exit_to_disable_us,
+                telemetry.monitor_reaction_us + telemetry.exit_to_disable_us);
+    } else {
+        append("\"monitor_reaction_us\": null, \"exit_to_disable_us\": null, \"limit_to_disable_us\": null}");
+    }
+}
+
+
+
+LONGLONG
+telemetry_now()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+
+
+BOOL
+telemetry_call(int call, BOOL ok)
+{
+    // Time since telemetry_call_start, set by TIMED() just before the call.
+    if (telemetry.op == NULL) return ok;
+    add_time(&telemetry.calls[call], to_us(telemetry_now() - telemetry_call_start));
+    return ok;
+}
+
+
+
+void
+telemetry_begin(const char *op)
+{
+    memset(&telemetry, 0, sizeof(telemetry));
+    QueryPerformanceFrequency(&telemetry.frequency);
+    telemetry.op = op;
+    telemetry.start = telemetry_now();
+    telemetry.exit_to_disable_us = -1;
+}
+
+
+
+void
+telemetry_wait_start()
+{
+    if (telemetry.op == NULL) return;
+    telemetry.last_poll = 0;
+    telemetry.previous_poll = 0;
+}
+
+
+
+void
+telemetry_poll()
+{
+    // Start of an iteration of wait_until(), before the condition is checked.
+    if (telemetry.op == NULL) return;
+    LONGLONG now = telemetry_now();
+    if (telemetry.last_poll != 0) {
+        add_time(&telemetry.iterations, to_us(now - telemetry.last_poll));
+        telemetry.wait_ticks += now - telemetry.last_poll;
+    }
+    telemetry.previous_poll = telemetry.last_poll;
+    telemetry.last_poll = now;
+}
+
+
+
+void
+telemetry_wait_end()
+{
+    // The last iteration ends here.
+    if (telemetry.op != NULL && telemetry.last_poll != 0) {
+        LONGLONG now = telemetry_now();
+        add_time(&telemetry.iterations, to_us(now - telemetry.last_poll));
+        telemetry.wait_ticks += now - telemetry.last_poll;
+    }
+}
+
+
+
+void
+telemetry_exit_seen()
+{
+    // Called when a wait for the monitor has seen it finish. It finished after the
+    // last poll which still saw it running began.
+    if (telemetry.op == NULL) return;
+    telemetry.exit_bound = (telemetry.previous_poll != 0) ? telemetry.previous_poll : telemetry.last_poll;
+}
+
+
+
+void
+telemetry_disabled()
+{
+    // Called once the axis is disabled after the monitor finished, an upper bound.
+    if (telemetry.op == NULL || telemetry.exit_bound == 0) return;
+    telemetry.exit_to_disable_us = to_us(telemetry_now() - telemetry.exit_bound);
+}
+
+
+
+void
+telemetry_monitor_reaction(DOUBLE us)
+{
+    if (telemetry.op == NULL) return;
+    telemetry.monitor_reaction_us = us;
+}
+
+
+
+void
+telemetry_end(int result)
+{
+    // Report the line and, if set, append to the log of all sessions.
+    if (telemetry.op == NULL) return;
+    build_report(result);
+    telemetry.op = NULL;
+    if (telemetry_output != NULL) {
+        telemetry_output(report);
+    } else {
+        fprintf(stderr, "telemetry %s\n", report);
+        fflush(stderr);
+    }
+
+    if (strlen(TELEMETRY_PATH) == 0) return;
+
+    FILE *f = fopen(TELEMETRY_PATH, "a");
+    if (f == NULL) {
+        rc_message("could not open %s", TELEMETRY_PATH);
+        return;
+    }
+    fprintf(f, "%s\n", report);
+    fclose(f);
+}
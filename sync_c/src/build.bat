@@ -0,0 +1,3 @@
+@echo on
+g++ -O2 -std=c++11 -o "..\exe\sync_fit.exe" sync_fit.cpp
+echo done
@@ -0,0 +1,258 @@
+// Recovers the coded sync pulses written by the Teensy SyncPulse library from an NI .bin recording,
+// and fits the NI sample index of each frame against Teensy time.
+//
+// usage: sync_fit <file.bin> <n_chan> <channel> <rate_hz> [period_us] [tick_us] [bits] [frames.csv]
+//
+//   file.bin       int16 recording with n_chan interleaved channels (as written by Saver)
+//   channel        1-based channel carrying the sync pulses
+//   rate_hz        NI sampling rate (config.nidaq.rate)
+//   period_us      SYNC_PERIOD_US (default 1000000)
+//   tick_us        SYNC_TICK_US (default 1000)
+//   bits           SYNC_BITS (default 16)
+//   frames.csv     optional, writes frame, sample and residual (us) for each frame used
+//
+// The fit is  sample = offset + slope * (teensy_us - SyncPulse::start_us),  where frame k is at k * period_us.
+// Output is one "name value" pair per line.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Must match sync_pulse.h
+#define SYNC_MARKER_TICKS   4
+#define SYNC_ZERO_TICKS     1
+#define SYNC_ONE_TICKS      2
+
+#define CHUNK_SAMPLES       65536
+#define REJECT_FACTOR       4       // frames with residuals beyond this multiple of the rms are dropped and the fit repeated
+
+
+struct Frame {
+    int64_t number;     // unwrapped frame number
+    double sample;      // interpolated sample index of the marker rising edge
+    double residual_us;
+    bool used;
+};
+
+
+struct Fit {
+    double offset;
+    double slope;
+    double rms_us;
+    double max_us;
+    int n;
+};
+
+
+
+// Streams one channel of the recording through a callback, in chunks.
+template <typename F>
+static bool
+for_each_sample(const char *fname, int n_chan, int channel, F f)
+{
+    FILE *fid = fopen(fname, "rb");
+    if (fid == NULL) {
+        printf("could not open %s\n", fname);
+        return false;
+    }
+
+    std::vector<int16_t> buf((size_t) CHUNK_SAMPLES * n_chan);
+    int64_t i = 0;
+    size_t n_read;
+
+    while ((n_read = fread(buf.data(), sizeof(int16_t) * n_chan, CHUNK_SAMPLES, fid)) > 0) {
+        for (size_t j = 0; j < n_read; j++) {
+            f(i++, buf[j * n_chan + channel]);
+        }
+    }
+
+    fclose(fid);
+    return true;
+}
+
+
+
+static Fit
+fit_frames(std::vector<Frame> &frames, double period_us, double rate_hz)
+{
+    Fit fit = {0, 0, 0, 0, 0};
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int64_t k0 = -1;
+
+    // Centre on the first used frame to keep the sums well conditioned over long recordings.
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (!frames[i].used) continue;
+        if (k0 < 0) k0 = frames[i].number;
+        double x = (frames[i].number - k0) * period_us;
+        double y = frames[i].sample - frames[0].sample;
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+        fit.n++;
+    }
+    if (fit.n < 2) return fit;
+
+    double mx = sx / fit.n, my = sy / fit.n;
+    fit.slope = (sxy - fit.n * mx * my) / (sxx - fit.n * mx * mx);
+    double offset_k0 = frames[0].sample + my - fit.slope * mx;
+
+    // Express the offset at frame 0 (Teensy time start_us).
+    fit.offset = offset_k0 - fit.slope * k0 * period_us;
+
+    double ss = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        double predicted = fit.offset + fit.slope * frames[i].number * period_us;
+        frames[i].residual_us = (frames[i].sample - predicted) * 1e6 / rate_hz;
+        if (!frames[i].used) continue;
+        ss += frames[i].residual_us * frames[i].residual_us;
+        if (fabs(frames[i].residual_us) > fit.max_us) fit.max_us = fabs(frames[i].residual_us);
+    }
+    fit.rms_us = sqrt(ss / fit.n);
+
+    return fit;
+}
+
+
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 5) {
+        printf("usage: sync_fit <file.bin> <n_chan> <channel> <rate_hz> [period_us] [tick_us] [bits] [frames.csv]\n");
+        return 1;
+    }
+
+    const char *fname = argv[1];
+    int n_chan = atoi(argv[2]);
+    int channel = atoi(argv[3]) - 1;
+    double rate_hz = atof(argv[4]);
+    double period_us = (argc > 5) ? atof(argv[5]) : 1000000;
+    double tick_us = (argc > 6) ? atof(argv[6]) : 1000;
+    int bits = (argc > 7) ? atoi(argv[7]) : 16;
+    const char *csv_fname = (argc > 8) ? argv[8] : NULL;
+
+    if (n_chan < 1 || channel < 0 || channel >= n_chan || rate_hz <= 0 || tick_us <= 0 || bits < 1 || bits > 31) {
+        printf("invalid arguments.\n");
+        return 1;
+    }
+
+    double samples_per_tick = rate_hz * tick_us / 1e6;
+    if (samples_per_tick < 2) {
+        printf("tick_us is too short for the sampling rate, pulse widths cannot be decoded.\n");
+        return 1;
+    }
+
+    // First pass: threshold half way between the low and high levels.
+    int16_t lo = INT16_MAX, hi = INT16_MIN;
+    bool ok = for_each_sample(fname, n_chan, channel, [&](int64_t, int16_t x) {
+        if (x < lo) lo = x;
+        if (x > hi) hi = x;
+    });
+    if (!ok) return 1;
+    if (hi - lo < 100) {
+        printf("no pulses found on channel %d.\n", channel + 1);
+        return 1;
+    }
+    double threshold = 0.5 * ((double) lo + hi);
+    double hysteresis = 0.1 * ((double) hi - lo);
+
+    // Second pass: measure pulse widths and decode frames.
+    std::vector<Frame> frames;
+    bool high = false;
+    int16_t previous = lo;
+    double rise = 0, marker_rise = 0;
+    int bit = -1;   // -1 = waiting for a marker
+    uint32_t code = 0;
+    int64_t n_bad = 0;
+
+    for_each_sample(fname, n_chan, channel, [&](int64_t i, int16_t x) {
+
+        if (!high && x > threshold + hysteresis) {
+            high = true;
+            // Interpolate the crossing of the threshold between this sample and the last.
+            double frac = (x != previous) ? (threshold - previous) / ((double) x - previous) : 1;
+            if (frac < 0 || frac > 1) frac = 1;
+            rise = (i - 1) + frac;
+        }
+        else if (high && x < threshold - hysteresis) {
+            high = false;
+            double frac = (x != previous) ? (threshold - previous) / ((double) x - previous) : 1;
+            if (frac < 0 || frac > 1) frac = 1;
+            double fall = (i - 1) + frac;
+            long ticks = lround((fall - rise) / samples_per_tick);
+
+            if (ticks == SYNC_MARKER_TICKS) {
+                if (bit >= 0) n_bad++;
+                marker_rise = rise;
+                bit = 0;
+                code = 0;
+            }
+            else if (bit >= 0 && (ticks == SYNC_ZERO_TICKS || ticks == SYNC_ONE_TICKS)) {
+                if (ticks == SYNC_ONE_TICKS) code |= (1u << bit);
+                if (++bit == bits) {
+                    Frame f = {code, marker_rise, 0, true};
+                    frames.push_back(f);
+                    bit = -1;
+                }
+            }
+            else if (bit >= 0) {
+                n_bad++;
+                bit = -1;
+            }
+        }
+        previous = x;
+    });
+
+    if (frames.size() < 2) {
+        printf("fewer than 2 frames decoded.\n");
+        return 1;
+    }
+
+    // Unwrap the frame counter, using the sample spacing to count whole wraps.
+    int64_t wrap = (int64_t) 1 << bits;
+    double samples_per_period = rate_hz * period_us / 1e6;
+    for (size_t i = 1; i < frames.size(); i++) {
+        int64_t elapsed = llround((frames[i].sample - frames[i - 1].sample) / samples_per_period);
+        int64_t expected = frames[i - 1].number + elapsed;
+        int64_t low = expected & (wrap - 1);
+        int64_t delta = (frames[i].number - low) & (wrap - 1);
+        if (delta > wrap / 2) delta -= wrap;
+        frames[i].number = expected + delta;
+    }
+
+    Fit fit = fit_frames(frames, period_us, rate_hz);
+    int n_rejected = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (fabs(frames[i].residual_us) > REJECT_FACTOR * fit.rms_us && fabs(frames[i].residual_us) > 1e6 / rate_hz) {
+            frames[i].used = false;
+            n_rejected++;
+        }
+    }
+    if (n_rejected > 0) fit = fit_frames(frames, period_us, rate_hz);
+
+    printf("frames %d\n", (int) frames.size());
+    printf("frames_rejected %d\n", n_rejected);
+    printf("frames_malformed %lld\n", (long long) n_bad);
+    printf("first_frame %lld\n", (long long) frames.front().number);
+    printf("last_frame %lld\n", (long long) frames.back().number);
+    printf("offset_samples %.6f\n", fit.offset);
+    printf("samples_per_teensy_us %.12f\n", fit.slope);
+    printf("drift_ppm %.4f\n", (fit.slope * 1e6 / rate_hz - 1) * 1e6);
+    printf("residual_rms_us %.3f\n", fit.rms_us);
+    printf("residual_max_us %.3f\n", fit.max_us);
+
+    if (csv_fname != NULL) {
+        FILE *csv = fopen(csv_fname, "w");
+        if (csv == NULL) {
+            printf("could not open %s\n", csv_fname);
+            return 1;
+        }
+        fprintf(csv, "frame,sample,residual_us,used\n");
+        for (size_t i = 0; i < frames.size(); i++) {
+            fprintf(csv, "%lld,%.4f,%.4f,%d\n", (long long) frames[i].number, frames[i].sample, frames[i].residual_us, (int) frames[i].used);
+        }
+        fclose(csv);
+    }
+
+    return 0;
+}
@@ -6,6 +6,9 @@
  */
 
 
+#include "options.h"
+#include "timebase.h"
+#include "gpio_snapshot.h"
 #include "velocity.h"
 #include "ao.h"
 #include "trigger_input.h"
@@ -27,8 +30,8 @@ TriggerInput trig_in = TriggerInput();
 
 
 bool wait_for_trigger = 1;
-unsigned long initial_time = millis();
-unsigned long now;
+uint64_t initial_time = 0;
+uint64_t now;
 unsigned long dt;
 float velocity = 0;
 
@@ -37,23 +40,28 @@ void
 setup() {
     // Protocol specific variables
     //    see class definition for details.
+    timebase.setup();
     ao.setup(DAC_OFFSET);
     vel.setup();
     vel.loop(0, MIN_VOLTS, DAC_OFFSET, 1);
-    trig_in.setup();
+    trig_in.setup(ZERO_POSITION_PIN);
 }
 
 
 void
 loop() {
 	
+	// Sample the time and the inputs once for every module in this iteration.
+	timebase.update();
+	gpio.capture();
+	
 	// Check state of the trigger input
     trig_in.loop();
 
     // If trigger input received, reset the time to to current time.
     if (trig_in.delta_state) {
     	wait_for_trigger = 0;
-        initial_time = millis();
+        initial_time = timebase.now_ms();
     }
 
     if (wait_for_trigger) {
@@ -61,9 +69,9 @@ loop() {
     }
 	
 	// Get current time
-	now = millis();
+	now = timebase.now_ms();
 	
-	dt = now - initial_time;
+	dt = (unsigned long) (now - initial_time);
 	
 	if (dt < DWELL_MS) {
 		return;
@@ -4,6 +4,7 @@
  * 1. monitoring the motion of a rotary encoder
  * 2. filtering the encoder signal
  * 3. outputing voltage signal of encoder velocity DEPENDENDING ON DIGITAL INPUTS WHICH CHANGES THE GAIN
+ * 4. if COMMAND_CHANNEL is set, accepting gain and output commands from the host over USB serial
  * 
  */
 
@@ -11,37 +12,37 @@
 #include "Arduino.h"
 #include "options.h"
 
+#include "timebase.h"
+#include "gpio_snapshot.h"
+#include "scheduler.h"
 #include "encoder.h"
 #include "velocity.h"
 #include "ao.h"
 #include "gain_control.h"
+#include "command_channel.h"
 
 
 class Encoder;
 Velocity vel = Velocity();
 AnalogOut ao = AnalogOut();
 GainControl gain = GainControl();
+Scheduler scheduler = Scheduler();
+CommandChannel channel = CommandChannel();
 int protocol = FORWARD_ONLY;
 float dac_offset_volts = 0.5;
 float min_volts = 0;
+bool disabled = 0;
+bool output_enabled = 1;
 
 
 void
-setup() {
-	
-	enc.setup(protocol);
-	ao.setup(dac_offset_volts);
-	vel.setup();
-	gain.setup();
-	pinMode(DISABLE_PIN, INPUT);
-}
+output_task(void *context) {
 
-
-void
-loop() {
+	// DISABLE_PIN is read here, so the output stops on the same iteration it goes high.
+	disabled = (gpio.read(DISABLE_PIN) == HIGH) || !output_enabled;
 
 	// Determine whether to update the voltage.
-	if (digitalRead(DISABLE_PIN) == HIGH) {
+	if (disabled) {
 		ao.loop(true, dac_offset_volts);
 		return;
 	}
@@ -49,18 +50,12 @@ loop() {
 	bool update = 0;
 	float volts = 0;
 	
-	// Check to make sure encoder has moved in last Xms
-	enc.loop();
-	
 	// Fix the encoder velocity and distance for each loop.
 	noInterrupts();
 	float encoder_velocity = enc.current_velocity;
 	float encoder_distance = enc.total_distance;
 	interrupts();
 
-	// Check state of the gain
-	gain.loop();
-
 	// Compute the velocity as a voltage
 	vel.loop(encoder_velocity, min_volts, dac_offset_volts, gain.value);
 
@@ -77,3 +72,88 @@ loop() {
 	
 	ao.loop(update, volts);
 }
+
+
+void
+gain_task(void *context) {
+
+	// Check state of the gain
+	gain.loop();
+}
+
+
+uint8_t
+handle_command(void *context, Command *cmd) {
+
+	// Gain commands ramp from the current gain, until the next change of the gain pins.
+	switch (cmd->command) {
+		case CMD_SET_GAIN:
+			gain.set(cmd->value1, cmd->value2);
+			return CMD_OK;
+
+		case CMD_ENABLE_OUTPUT:
+			output_enabled = 1;
+			return CMD_OK;
+
+		case CMD_DISABLE_OUTPUT:
+			output_enabled = 0;
+			return CMD_OK;
+
+		case CMD_ZERO_DISTANCE:
+			noInterrupts();
+			enc.total_distance = 0;
+			interrupts();
+			return CMD_OK;
+	}
+	return CMD_UNKNOWN;
+}
+
+
+void
+command_task(void *context) {
+
+	// Read and apply host commands.
+	channel.loop();
+}
+
+
+void
+encoder_task(void *context) {
+
+	// Check to make sure encoder has moved in last Xms
+	enc.loop();
+}
+
+
+void
+setup() {
+	
+	timebase.setup();
+	enc.setup(protocol);
+	ao.setup(dac_offset_volts);
+	vel.setup();
+	gain.setup();
+	pinMode(DISABLE_PIN, INPUT);
+	gpio.watch(DISABLE_PIN);
+	if (COMMAND_CHANNEL) {
+		channel.setup(handle_command, NULL);
+	}
+	
+	scheduler.add(gain_task, NULL, TRIGGER_INPUT_TASK_US, 0);
+	scheduler.add(output_task, NULL, OUTPUT_TASK_US, 0);
+	scheduler.add(encoder_task, NULL, ENCODER_TASK_US, 2);
+	if (COMMAND_CHANNEL) {
+		scheduler.add(command_task, NULL, COMMAND_TASK_US, 1);
+	}
+}
+
+
+void
+loop() {
+
+	// Sample the time and the inputs once for every task in this iteration.
+	timebase.update();
+	gpio.capture();
+	
+	scheduler.run();
+}
@@ -2,11 +2,56 @@
 #include "ao.h"
 
 
+IntervalTimer shaping_timer;
+AnalogOut *AnalogOut::_active = 0;
+
+
 AnalogOut::AnalogOut() {
 }
 
 
 
+int32_t
+AnalogOut::_volts_to_q16(float volts) {
+
+    float temp = volts * (float) this->_max_dac_bits / this->_max_dac_volts;
+    if ( temp > this->_max_dac_bits ) temp = this->_max_dac_bits;
+    if ( temp < 0 ) temp = 0;
+    return (int32_t) (temp * 65536.0f);
+}
+
+
+
+void
+AnalogOut::_shape() {
+
+    // Runs at DAC_SHAPING_HZ. Quantise the target plus the filtered quantisation
+    //  error of previous samples, so that the error is pushed to high frequencies
+    //  and the average output resolves fractions of one DAC step.
+    AnalogOut *ao = AnalogOut::_active;
+    int32_t v = ao->_target_q;
+    if ( ao->_noise_shaping == 1 ) {
+        v += ao->_error_1;
+    } else {
+        v += 2 * ao->_error_1 - ao->_error_2;
+    }
+
+    int32_t q = (v + 32768) >> 16;
+    if ( q > ao->_max_dac_bits ) q = ao->_max_dac_bits;
+    if ( q < 0 ) q = 0;
+
+    ao->_error_2 = ao->_error_1;
+    ao->_error_1 = v - (q << 16);
+
+    // Bound the error so it cannot wind up while the output is clamped.
+    if ( ao->_error_1 > 65536 ) ao->_error_1 = 65536;
+    if ( ao->_error_1 < -65536 ) ao->_error_1 = -65536;
+
+    *(volatile int16_t *) &(DAC0_DAT0L) = q;
+}
+
+
+
 uint16_t
 AnalogOut::_volts_to_bits(float volts) {
 
@@ -23,6 +68,7 @@ AnalogOut::_write(uint16_t value) {
     if ( value > this->_max_dac_bits ) value = this->_max_dac_bits;
     if ( value < 0 ) value = 0;
     analogWrite(DAC_PIN, value);
+    this->last_bits = value;
 }
 
 
@@ -32,6 +78,12 @@ AnalogOut::setup(float offset) {
 
     analogWriteResolution(12);
     this->_write(this->_volts_to_bits(offset));
+
+    if ( this->_noise_shaping ) {
+        this->_target_q = this->_volts_to_q16(offset);
+        AnalogOut::_active = this;
+        shaping_timer.begin(this->_shape, 1e6 / DAC_SHAPING_HZ);
+    }
 }
 
 
@@ -40,6 +92,12 @@ void
 AnalogOut::loop(bool update, float voltage) {
 
     if (update) {
-        this->_write(this->_volts_to_bits(voltage));
+        if ( this->_noise_shaping ) {
+            // The shaping interrupt picks up the new target on its next sample.
+            this->_target_q = this->_volts_to_q16(voltage);
+            this->last_bits = (this->_target_q + 32768) >> 16;
+        } else {
+            this->_write(this->_volts_to_bits(voltage));
+        }
     }
 }
@@ -1,6 +1,7 @@
 #ifndef ANALOG_OUTPUT_H
 #define ANALOG_OUTPUT_H
 
+#include <stdint.h>
 #include "options.h"
 
 /*!
@@ -18,11 +19,15 @@ class AnalogOut {
         void setup (float dac_offset_volts);
 
         /*! Writes the given voltage value to the output, dependent on the `update` bool.
+            With DAC_NOISE_SHAPING the value becomes the target of the noise shaping interrupt instead.
             \param update Update bool
             \param voltage Voltage float
         */
         void loop(bool update, float voltage);
 
+        //! DAC code last written, or the nearest code to the target when noise shaping.
+        uint16_t last_bits = 0;
+
     private:
         /*! Converts a voltage value to a uint16_t value suitable for writing to the output.
             \param volts Voltage float
@@ -34,6 +39,27 @@ class AnalogOut {
             \param bits Write bits
         */
         void _write (uint16_t bits);
+
+        /*! Converts a voltage value to a DAC code with 16 fractional bits.
+            \param volts Voltage float
+        */
+        int32_t _volts_to_q16 (float volts);
+
+        //! Attached to the shaping timer. Writes one noise-shaped sample of ::_target_q to the DAC.
+        static void _shape ();
+
+        //! Instance driven by the shaping timer.
+        static AnalogOut *_active;
+
+        //! 0 = off, 1 = first-order, 2 = second-order noise shaping.
+        const int _noise_shaping = DAC_NOISE_SHAPING;
+
+        //! Target DAC code with 16 fractional bits.
+        volatile int32_t _target_q = 0;
+
+        //! Quantisation error of the last two samples, 16 fractional bits.
+        int32_t _error_1 = 0;
+        int32_t _error_2 = 0;
         
         //! Max DAC volts - TODO how to reference #define MAX_DAC_VOLTS in options.h
         float _max_dac_volts = MAX_DAC_VOLTS;
@@ -0,0 +1,215 @@
+#include <string.h>
+#include "Arduino.h"
+#include "command_channel.h"
+#include "timebase.h"
+
+
+
+CommandChannel::CommandChannel() {
+}
+
+
+
+// Sum of the bytes modulo 256. A packet with a valid checksum sums to 0.
+static uint8_t
+_sum(const uint8_t *bytes, int n) {
+
+    uint8_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+
+
+void
+CommandChannel::setup(CommandHandler handler, void *context) {
+
+    // Baud rate is ignored for USB serial.
+    Serial.begin(9600);
+    this->_handler = handler;
+    this->_context = context;
+
+    for (int i = 0; i < this->_queue_length; i++) {
+        this->_queued[i] = 0;
+    }
+}
+
+
+
+void
+CommandChannel::_ack(Command *cmd, uint8_t status) {
+
+    uint8_t ack[ACK_PACKET_BYTES];
+    uint64_t now = timebase.now_us();
+
+    ack[0] = ACK_SYNC;
+    ack[1] = cmd->command;
+    memcpy(ack + 2, &cmd->sequence, 2);
+    ack[4] = status;
+    ack[5] = 0;
+    memcpy(ack + 6, &cmd->reply_length, 2);
+    memcpy(ack + 8, &now, 8);
+    ack[5] = (uint8_t) -_sum(ack, ACK_PACKET_BYTES);
+
+    // Kept in case the host misses it and resends the command. The reply is copied, as the
+    //  buffer it points to may be updated by then (e.g. the statistics).
+    memcpy(this->_last_ack, ack, ACK_PACKET_BYTES);
+    this->_last_reply = cmd->reply;
+    this->_last_reply_length = cmd->reply_length;
+    if (cmd->reply_length > 0 && cmd->reply_length <= COMMAND_REPLY_BYTES) {
+        memcpy(this->_reply, cmd->reply, cmd->reply_length);
+        this->_last_reply = this->_reply;
+    }
+    this->_resend_ack();
+}
+
+
+
+void
+CommandChannel::_resend_ack() {
+
+    this->_sent = 0;
+    this->_to_send = ACK_PACKET_BYTES + this->_last_reply_length;
+    this->_send();
+}
+
+
+
+void
+CommandChannel::_send() {
+
+    // Only write what the USB buffer takes now, so that a long reply (e.g. the scope dump)
+    //  is sent over several calls to loop() without holding up the other tasks.
+    while (this->_sent < this->_to_send) {
+        int space = Serial.availableForWrite();
+        if (space <= 0) return;
+
+        const uint8_t *from;
+        int n;
+        if (this->_sent < ACK_PACKET_BYTES) {
+            from = this->_last_ack + this->_sent;
+            n = ACK_PACKET_BYTES - this->_sent;
+        } else {
+            from = this->_last_reply + (this->_sent - ACK_PACKET_BYTES);
+            n = this->_to_send - this->_sent;
+        }
+        if (n > space) n = space;
+        Serial.write(from, n);
+        this->_sent += n;
+    }
+    Serial.send_now();
+}
+
+
+
+void
+CommandChannel::_apply(Command *cmd) {
+
+    cmd->reply = 0;
+    cmd->reply_length = 0;
+
+    uint8_t status = CMD_OK;
+    if (cmd->command != CMD_PING) {
+        status = this->_handler(this->_context, cmd);
+    }
+    this->_ack(cmd, status);
+}
+
+
+
+void
+CommandChannel::_receive() {
+
+    Command cmd;
+    cmd.command = this->_packet[1];
+    memcpy(&cmd.sequence, this->_packet + 2, 2);
+    memcpy(&cmd.execute_at, this->_packet + 4, 4);
+    memcpy(&cmd.value1, this->_packet + 8, 4);
+    memcpy(&cmd.value2, this->_packet + 12, 4);
+    cmd.reply = 0;
+    cmd.reply_length = 0;
+
+    // The host resends a command it has no acknowledgement for. Never apply it twice: acknowledge
+    //  it again if it has been applied, otherwise its acknowledgement is still to come.
+    if (this->_any_received && cmd.sequence == this->_last_sequence && cmd.command == this->_last_command) {
+        uint16_t acked;
+        memcpy(&acked, this->_last_ack + 2, 2);
+        if (this->_last_ack[0] == ACK_SYNC && this->_last_ack[1] == cmd.command && acked == cmd.sequence) {
+            this->_resend_ack();
+        }
+        return;
+    }
+    this->_any_received = 1;
+    this->_last_sequence = cmd.sequence;
+    this->_last_command = cmd.command;
+
+    if (cmd.execute_at == 0) {
+        this->_apply(&cmd);
+        return;
+    }
+
+    for (int i = 0; i < this->_queue_length; i++) {
+        if (!this->_queued[i]) {
+            this->_queue[i] = cmd;
+            this->_queued[i] = 1;
+            return;
+        }
+    }
+    this->_ack(&cmd, CMD_QUEUE_FULL);
+}
+
+
+
+void
+CommandChannel::_resync() {
+
+    int start = 1;
+    while (start < this->_received && this->_packet[start] != CMD_SYNC) {
+        start++;
+    }
+    this->_received -= start;
+    memmove(this->_packet, this->_packet + start, this->_received);
+}
+
+
+
+void
+CommandChannel::loop() {
+
+    // Finish sending the last acknowledgement and reply before anything else, so that
+    //  other acknowledgements are not mixed into it.
+    if (this->_sent < this->_to_send) {
+        this->_send();
+        return;
+    }
+
+    // Assemble packets, discarding bytes until a sync byte starts one.
+    while (Serial.available() > 0 && this->_sent == this->_to_send) {
+        uint8_t byte = Serial.read();
+        if (this->_received == 0 && byte != CMD_SYNC) continue;
+        this->_packet[this->_received++] = byte;
+        if (this->_received < CMD_PACKET_BYTES) continue;
+
+        // A bad packet may have started at a stray sync byte, the real one can be within it.
+        if (_sum(this->_packet, CMD_PACKET_BYTES) != 0) {
+            this->bad_packets++;
+            this->_resync();
+            continue;
+        }
+        this->_received = 0;
+        this->_receive();
+    }
+
+    // Apply scheduled commands which are due, once any reply has been sent. The signed
+    //  difference keeps this correct across the 32-bit wrap of execute_at.
+    if (this->_sent < this->_to_send) return;
+    uint32_t now = (uint32_t) timebase.now_us();
+    for (int i = 0; i < this->_queue_length; i++) {
+        if (this->_queued[i] && (int32_t) (now - this->_queue[i].execute_at) >= 0) {
+            this->_queued[i] = 0;
+            this->_apply(&this->_queue[i]);
+        }
+    }
+}
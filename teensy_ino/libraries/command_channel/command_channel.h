@@ -0,0 +1,146 @@
+#ifndef COMMAND_CHANNEL_H
+#define COMMAND_CHANNEL_H
+
+#include <stdint.h>
+#include "options.h"
+
+// Command codes
+#define CMD_PING                0x00    // no effect, acknowledges with the current time
+#define CMD_SET_GAIN            0x01    // value1 = gain, value2 = ramp duration (ms)
+#define CMD_ENABLE_OUTPUT       0x02    // output follows the encoder velocity
+#define CMD_DISABLE_OUTPUT      0x03    // output is held at the offset voltage
+#define CMD_ZERO_DISTANCE       0x04    // reset the encoder distance to zero
+#define CMD_RESET_STATS         0x05    // start a new SessionStats window
+#define CMD_GET_STATS           0x06    // reply is the SessionSummary of the current window
+#define CMD_GAIN_MAP_CLEAR      0x07    // empty the pending gain map
+#define CMD_GAIN_MAP_POINT      0x08    // value1 = position (mm), value2 = gain, appended to the pending gain map
+#define CMD_GAIN_MAP_APPLY      0x09    // make the pending gain map active
+#define CMD_SCOPE_ARM           0x0A    // value1 = trigger source mask, value2 = velocity threshold (mm/s), clear and rearm the capture
+#define CMD_SCOPE_DUMP          0x0B    // reply is the ScopeHeader and samples of the capture, freezing it if still running
+
+// Acknowledgement status
+#define CMD_OK                  0
+#define CMD_UNKNOWN             1
+#define CMD_QUEUE_FULL          2
+#define CMD_INVALID             3
+
+// Framing
+#define CMD_SYNC                0xA5
+#define ACK_SYNC                0x5A
+#define CMD_PACKET_BYTES        17
+#define ACK_PACKET_BYTES        16
+
+
+/*!
+    A command received from the host.
+
+    On the wire (17 bytes, little-endian): sync (0xA5), command, sequence (uint16),
+    execute_at (uint32, low 32 bits of Timebase::now_us(), 0 = immediately), value1 (float), value2 (float),
+    checksum (uint8, chosen so that all 17 bytes sum to 0 modulo 256).
+*/
+struct Command {
+    uint8_t command;
+    uint16_t sequence;
+    uint32_t execute_at;
+    float value1;
+    float value2;
+
+    /*! Optional reply payload, sent after the acknowledgement. Set by the handler. Replies up to COMMAND_REPLY_BYTES
+        are copied when acknowledged; a longer one must stay unchanged until the next command (e.g. the frozen scope). */
+    const uint8_t *reply;
+    uint16_t reply_length;
+};
+
+//! Applies a command. Returns an acknowledgement status.
+typedef uint8_t (*CommandHandler)(void *context, Command *cmd);
+
+
+/*!
+    Binary command channel over USB serial.
+
+    Each command is acknowledged once it has been applied (16 bytes, little-endian): sync (0x5A), command, sequence (uint16),
+    status, checksum, reply length (uint16), time applied (uint64, Timebase::now_us()), followed by any reply payload.
+    The checksum makes the 16 acknowledgement bytes sum to 0 modulo 256; it does not cover the reply.
+    Commands with a non-zero execute_at are held until that time.
+    A long reply is sent a USB buffer at a time over several calls to loop(); no other command is
+    read or applied until it has been sent.
+
+    A packet with a bad checksum is dropped without an acknowledgement, and reception restarts at the next
+    sync byte within it, so the channel recovers from lost or spurious bytes. The host should resend a
+    command which is not acknowledged, with the same sequence number. A resend of the last command is not
+    applied again, but acknowledged again if it has already been applied, with the same reply.
+*/
+class CommandChannel {
+
+    public:
+        //! CommandChannel constructor
+        CommandChannel();
+
+        /*! Open the serial port and set the function which applies commands.
+            \param handler Function applying each command.
+            \param context Pointer passed to the handler.
+        */
+        void setup (CommandHandler handler, void *context);
+
+        //! Main loop method. Reads complete packets and applies commands which are due.
+        void loop ();
+
+        //! Number of packets dropped for a bad checksum.
+        uint32_t bad_packets = 0;
+
+    private:
+        //! Drop the first byte of ::_packet and restart it at the next sync byte received so far.
+        void _resync ();
+
+        //! Parse ::_packet into a Command and apply it now or queue it.
+        void _receive ();
+
+        /*! Apply a command and send its acknowledgement.
+            \param cmd Command to apply.
+        */
+        void _apply (Command *cmd);
+
+        /*! Send an acknowledgement with no effect.
+            \param cmd Command being acknowledged.
+            \param status Acknowledgement status.
+        */
+        void _ack (Command *cmd, uint8_t status);
+
+        //! Start sending the last acknowledgement and its reply (again).
+        void _resend_ack ();
+
+        //! Send as much of the acknowledgement and reply as the USB buffer takes.
+        void _send ();
+
+        CommandHandler _handler = 0;
+        void *_context = 0;
+
+        //! Bytes of the packet being received.
+        uint8_t _packet[CMD_PACKET_BYTES];
+        int _received = 0;
+
+        //! Sequence number and command of the last packet received, to recognise a resend.
+        bool _any_received = 0;
+        uint16_t _last_sequence = 0;
+        uint8_t _last_command = 0;
+
+        //! Last acknowledgement sent and its reply, which points to ::_reply unless it is longer.
+        uint8_t _last_ack[ACK_PACKET_BYTES] = {0};
+        const uint8_t *_last_reply = 0;
+        uint16_t _last_reply_length = 0;
+
+        //! Copy of the last reply, as the handler's buffer may change before a resend.
+        uint8_t _reply[COMMAND_REPLY_BYTES];
+
+        //! Bytes of the acknowledgement and reply sent so far, and in all.
+        int _sent = 0;
+        int _to_send = 0;
+
+        //! Commands waiting for their execute_at time.
+        static const int _queue_length = COMMAND_QUEUE_LENGTH;
+        Command _queue[_queue_length];
+        bool _queued[_queue_length];
+};
+
+
+#endif  /* COMMAND_CHANNEL_H */
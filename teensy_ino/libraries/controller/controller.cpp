@@ -2,11 +2,21 @@
 #include "controller.h"
 #include "options.h"
 
+#include "timebase.h"
+#include "gpio_snapshot.h"
 #include "encoder.h"
 #include "velocity.h"
 #include "ao.h"
 #include "trigger_input.h"
 #include "trigger_output.h"
+#include "coupling_monitor.h"
+#include "distance_out.h"
+#include "gain_control.h"
+#include "command_channel.h"
+#include "sync_pulse.h"
+#include "session_stats.h"
+#include "gain_map.h"
+#include "scope.h"
 
 
 
@@ -15,6 +25,12 @@ Velocity vel = Velocity();
 AnalogOut ao = AnalogOut();
 TriggerInput trig_in = TriggerInput();
 TriggerOutput trig_out = TriggerOutput();
+DistanceOut dist_out = DistanceOut();
+GainControl host_gain = GainControl();
+CommandChannel channel = CommandChannel();
+SessionStats stats = SessionStats();
+GainMap gain_map = GainMap();
+Scope scope = Scope();
 
 
 
@@ -26,12 +42,51 @@ Controller::Controller() {
 void
 Controller::setup() {
 
+    timebase.setup();
     enc.setup(this->protocol);
     ao.setup(this->dac_offset_volts);
+    if (this->_distance_out) {
+        dist_out.setup();
+    }
     vel.setup();
     trig_in.setup(ZERO_POSITION_PIN);
     trig_out.setup(REWARD_PIN);
     pinMode(DISABLE_PIN, INPUT);
+    gpio.watch(DISABLE_PIN);
+    if (this->_coupling_monitor) {
+        coupling.setup();
+    }
+    if (this->_command_channel) {
+        channel.setup(this->_handle_command, this);
+    }
+    if (this->_sync_pulse) {
+        sync_pulse.setup();
+    }
+    if (this->_session_stats) {
+        stats.setup();
+    }
+    if (this->_scope) {
+        scope.setup();
+    }
+
+    // The velocity-to-DAC path runs at priority 0, with the trigger input which resets the
+    //  distance it outputs. Everything else is background.
+    this->scheduler.add(this->_trigger_input_task, this, TRIGGER_INPUT_TASK_US, 0);
+    this->scheduler.add(this->_output_task, this, OUTPUT_TASK_US, 0);
+    if (this->_scope) {
+        this->scheduler.add(this->_scope_task, this, SCOPE_SAMPLE_US, 0);
+    }
+    this->scheduler.add(this->_encoder_task, this, ENCODER_TASK_US, 2);
+    this->scheduler.add(this->_trigger_output_task, this, TRIGGER_OUTPUT_TASK_US, 2);
+    if (this->_command_channel) {
+        this->scheduler.add(this->_command_task, this, COMMAND_TASK_US, 1);
+    }
+    if (this->_session_stats) {
+        this->scheduler.add(this->_stats_task, this, STATS_TASK_US, 2);
+    }
+    if (this->_coupling_monitor) {
+        this->scheduler.add(this->_coupling_task, this, COUPLING_TASK_US, 3);
+    }
 }
 
 
@@ -39,28 +94,42 @@ Controller::setup() {
 void
 Controller::loop() {
 
+    // Sample the time and the inputs once for every task in this iteration.
+    timebase.update();
+    gpio.capture();
+
+    this->scheduler.run();
+}
+
+
+
+void
+Controller::_output_task(void *context) {
+
+    Controller *ctl = (Controller *) context;
     bool update = 0;
     float volts = 0;
-    
-    // Check to make sure encoder has moved in last Xms
-    enc.loop();
 
-    // Check state of the trigger input
-    trig_in.loop();
+    // DISABLE_PIN is read here, so the output stops on the same iteration it goes high.
+    ctl->_disabled = (gpio.read(DISABLE_PIN) == HIGH);
 
-    // If trigger input received, reset the distance to zero.
-    if (trig_in.delta_state) {
-        enc.total_distance = 0;
-    }
-    
     // Fix the encoder velocity and distance for each loop.
     noInterrupts();
     float encoder_velocity = enc.current_velocity;
     float encoder_distance = enc.total_distance;
     interrupts();
 
+    // Advance any gain ramp requested by the host, and apply the gain at this position.
+    host_gain.update();
+    float gain = host_gain.value;
+    if (ctl->_gain_map) {
+        gain *= gain_map.gain(encoder_distance);
+    }
+
+    ctl->_gain = gain;
+
     // Compute the velocity as a voltage
-    vel.loop(encoder_velocity, this->min_volts, this->dac_offset_volts, 1);
+    vel.loop(encoder_velocity, ctl->min_volts, ctl->dac_offset_volts, gain);
 
     // Do we need to update the voltage?
     update = vel.update;
@@ -73,15 +142,181 @@ Controller::loop() {
         noInterrupts();
         enc.total_distance = 0;
         interrupts();
+        encoder_distance = 0;
     }
 
-    // Check status of trigger output.
-    trig_out.loop();
-    
     // Determine whether to update the voltage.
-    if (digitalRead(DISABLE_PIN) == LOW) {
+    if (!ctl->_disabled && ctl->_output_enabled) {
         ao.loop(update, volts);
     } else {
-        ao.loop(true, this->dac_offset_volts);
+        volts = ctl->dac_offset_volts;
+        ao.loop(true, volts);
+    }
+
+    ctl->_volts = volts;
+
+    // Distance goes out alongside velocity.
+    if (ctl->_distance_out) {
+        dist_out.loop(encoder_distance);
+    }
+
+    // Tell the coupling monitor which velocity we are commanding.
+    if (ctl->_coupling_monitor) {
+        coupling.command((volts - ctl->dac_offset_volts) * MAX_VELOCITY / MAX_VOLTS);
+    }
+}
+
+
+
+void
+Controller::_scope_task(void *context) {
+
+    Controller *ctl = (Controller *) context;
+    ScopeSample sample;
+
+    noInterrupts();
+    sample.edges = enc.edges;
+    sample.velocity_mm_s = enc.current_velocity;
+    interrupts();
+
+    sample.time_us = (uint32_t) timebase.now_us();
+    sample.output_mm_s = (ctl->_volts - ctl->dac_offset_volts) * MAX_VELOCITY / MAX_VOLTS;
+    sample.gain = ctl->_gain;
+    sample.dac_bits = ao.last_bits;
+    sample.flags = 0;
+    sample.reserved = 0;
+    if (trig_in.current_state == HIGH) sample.flags |= SCOPE_TRIGGER_IN;
+    if (trig_out.on()) sample.flags |= SCOPE_REWARD;
+    if (ctl->_disabled) sample.flags |= SCOPE_DISABLE;
+
+    scope.record(&sample);
+}
+
+
+
+void
+Controller::_trigger_input_task(void *context) {
+
+    Controller *ctl = (Controller *) context;
+
+    // Check state of the trigger input
+    trig_in.loop();
+
+    // If trigger input received, reset the distance to zero and start a new statistics window.
+    if (trig_in.delta_state) {
+        noInterrupts();
+        enc.total_distance = 0;
+        interrupts();
+        if (ctl->_session_stats) {
+            stats.reset();
+        }
+    }
+}
+
+
+
+void
+Controller::_encoder_task(void *context) {
+
+    // Check to make sure encoder has moved in last Xms
+    enc.loop();
+}
+
+
+
+void
+Controller::_trigger_output_task(void *context) {
+
+    // Check status of trigger output.
+    trig_out.loop();
+}
+
+
+
+void
+Controller::_coupling_task(void *context) {
+
+    // Compare the velocity we are commanding with the velocity the stage reports.
+    coupling.loop();
+}
+
+
+
+void
+Controller::_stats_task(void *context) {
+
+    // Add the time since the last update to the session statistics.
+    stats.loop();
+}
+
+
+
+void
+Controller::_command_task(void *context) {
+
+    // Read and apply host commands.
+    channel.loop();
+}
+
+
+
+uint8_t
+Controller::_handle_command(void *context, Command *cmd) {
+
+    Controller *ctl = (Controller *) context;
+
+    switch (cmd->command) {
+        case CMD_SET_GAIN:
+            host_gain.set(cmd->value1, cmd->value2);
+            return CMD_OK;
+
+        case CMD_ENABLE_OUTPUT:
+            ctl->_output_enabled = 1;
+            return CMD_OK;
+
+        case CMD_DISABLE_OUTPUT:
+            ctl->_output_enabled = 0;
+            return CMD_OK;
+
+        case CMD_ZERO_DISTANCE:
+            noInterrupts();
+            enc.total_distance = 0;
+            interrupts();
+            return CMD_OK;
+
+        case CMD_GAIN_MAP_CLEAR:
+            if (!ctl->_gain_map) break;
+            gain_map.clear();
+            return CMD_OK;
+
+        case CMD_GAIN_MAP_POINT:
+            if (!ctl->_gain_map) break;
+            return gain_map.add(cmd->value1, cmd->value2) ? CMD_OK : CMD_INVALID;
+
+        case CMD_GAIN_MAP_APPLY:
+            if (!ctl->_gain_map) break;
+            gain_map.apply();
+            return CMD_OK;
+
+        case CMD_SCOPE_ARM:
+            if (!ctl->_scope) break;
+            scope.arm((uint8_t) cmd->value1, cmd->value2);
+            return CMD_OK;
+
+        case CMD_SCOPE_DUMP:
+            if (!ctl->_scope) break;
+            cmd->reply = scope.dump(&cmd->reply_length);
+            return CMD_OK;
+
+        case CMD_RESET_STATS:
+            if (!ctl->_session_stats) break;
+            stats.reset();
+            return CMD_OK;
+
+        case CMD_GET_STATS:
+            if (!ctl->_session_stats) break;
+            cmd->reply = stats.summary(&cmd->reply_length);
+            return CMD_OK;
     }
+    return CMD_UNKNOWN;
 }
@@ -1,6 +1,9 @@
 #ifndef CONTROLLER_H
 #define CONTROLLER_H
 
+#include "options.h"
+#include "scheduler.h"
+#include "command_channel.h"
 
 /*
 *    Controller class
@@ -29,7 +32,7 @@ class Controller {
         /*! Sets up the Controller class and any other associated classes as well as pin IDs and modes. */
         void setup ();
 
-        /*! Main loop. Monitors triggers and velocity. */
+        /*! Main loop. Samples the timebase and runs the tasks which are due. */
         void loop ();
 
         //! The protocol being run.
@@ -40,6 +43,68 @@ class Controller {
 
         //! How far below the ::dac_offset_volts is allowed. Should be a non-positive float with abs() < ::dac_offset_volts.
         float min_volts;
+
+        //! Runs each subsystem at its own rate. Exposes per-task overrun counters and execution times.
+        Scheduler scheduler;
+
+    private:
+        //! Priority 0 task. Reads DISABLE_PIN, filters the encoder velocity, checks distance and writes the analog output.
+        static void _output_task (void *context);
+
+        //! Priority 0 task. Records a sample of the controller state in the Scope.
+        static void _scope_task (void *context);
+
+        //! Priority 0 task. Polls the trigger input and resets the distance (and session statistics) on a change.
+        static void _trigger_input_task (void *context);
+
+        //! Sets the encoder velocity to zero after the encoder timeout.
+        static void _encoder_task (void *context);
+
+        //! Ends the trigger output after its duration.
+        static void _trigger_output_task (void *context);
+
+        //! Processes samples taken by the CouplingMonitor.
+        static void _coupling_task (void *context);
+
+        //! Updates the session statistics.
+        static void _stats_task (void *context);
+
+        //! Reads and applies host commands on the CommandChannel.
+        static void _command_task (void *context);
+
+        //! Applies a host command. Passed to the CommandChannel.
+        static uint8_t _handle_command (void *context, Command *cmd);
+
+        //! Whether DISABLE_PIN was high when last read.
+        bool _disabled = 0;
+
+        //! Whether the host has enabled the output (CMD_ENABLE_OUTPUT / CMD_DISABLE_OUTPUT).
+        bool _output_enabled = 1;
+
+        //! Whether to listen for host commands over USB serial.
+        const bool _command_channel = COMMAND_CHANNEL;
+
+        //! Whether to multiply the gain by the GainMap at the current distance.
+        const bool _gain_map = GAIN_MAP;
+
+        //! Whether to keep a pre/post-trigger capture in the Scope.
+        const bool _scope = SCOPE;
+
+        //! Gain and voltage of the last output, for the Scope.
+        float _gain = 1;
+        float _volts = 0;
+
+        //! Whether to keep session statistics.
+        const bool _session_stats = SESSION_STATS;
+
+        //! Whether to write coded sync pulses on SYNC_PIN.
+        const bool _sync_pulse = SYNC_PULSE;
+
+        //! Whether to run the CouplingMonitor against the Soloist tracking output.
+        const bool _coupling_monitor = COUPLING_MONITOR;
+
+        //! Whether to output distance on the DistanceOut.
+        const bool _distance_out = DISTANCE_OUT;
 };
 
 
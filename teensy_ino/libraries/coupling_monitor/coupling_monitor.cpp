@@ -0,0 +1,143 @@
+#include "Arduino.h"
+#include "coupling_monitor.h"
+#include "options.h"
+
+
+IntervalTimer coupling_timer;
+
+
+
+CouplingMonitor::CouplingMonitor() {
+}
+
+
+
+void
+CouplingMonitor::_sample() {
+
+    // The conversion started on the last tick should long be done. Waiting for it
+    // here would block every other interrupt, so a late one is skipped instead.
+    if ( !(ADC0_SC1A & ADC_SC1_COCO) ) {
+        coupling.adc_misses++;
+        return;
+    }
+    uint16_t bits = ADC0_RA;
+    int16_t cmd = coupling._conversion_command;
+
+    // Start the conversion for the next tick, with the command at this time.
+    coupling._conversion_command = coupling._command;
+    ADC0_SC1A = coupling._adc_channel;
+
+    // Convert the tracking voltage back to stage velocity.
+    float volts = bits * MAX_DAC_VOLTS / MAX_DAC_BITS;
+    float act = (volts - coupling._ai_offset) * coupling._mm_s_per_volt;
+
+    uint32_t head = coupling._head;
+    if ( (head - coupling._tail) >= (uint32_t) coupling._queue_length ) {
+        coupling.overflows++;
+        return;
+    }
+
+    uint32_t i = head & (coupling._queue_length - 1);
+    coupling._queue_cmd[i] = cmd;
+    coupling._queue_act[i] = (int16_t) act;
+    coupling._head = head + 1;
+}
+
+
+
+void
+CouplingMonitor::_process(int16_t cmd, int16_t act) {
+
+    // Store the command so that _history[(idx - k) mod n] is the command k samples ago.
+    this->_history_idx = (this->_history_idx + 1) % (this->_max_lag + 1);
+    this->_history[this->_history_idx] = cmd;
+
+    // Exponentially weighted products of the lagged command with the actual velocity.
+    int best = this->_lag;
+    int32_t best_value = 0;
+    for (int k = 0; k <= this->_max_lag; k++) {
+        int idx = (this->_history_idx - k + this->_max_lag + 1) % (this->_max_lag + 1);
+        int32_t product = (int32_t) this->_history[idx] * act;
+        this->_correlation[k] += (product - this->_correlation[k]) >> this->_shift;
+        if (this->_correlation[k] > best_value) {
+            best_value = this->_correlation[k];
+            best = k;
+        }
+    }
+
+    // Only trust the lag while there is enough motion to correlate.
+    if (best_value > this->_min_correlation) {
+        this->_lag = best;
+    }
+
+    // Error between the actual velocity and the command it is tracking.
+    int idx = (this->_history_idx - this->_lag + this->_max_lag + 1) % (this->_max_lag + 1);
+    int32_t err = abs(act - this->_history[idx]) << this->_shift;
+    this->_error_acc += (err - this->_error_acc) >> this->_shift;
+}
+
+
+
+void
+CouplingMonitor::setup() {
+
+    pinMode(COUPLING_FAULT_PIN, OUTPUT);
+    digitalWrite(COUPLING_FAULT_PIN, LOW);
+    analogReadResolution(12);
+
+    // Let the core set up and calibrate ADC0 and select the pin's channel, then keep
+    // the channel to start conversions from the timer without analogRead().
+    analogRead(COUPLING_AI_PIN);
+    this->_adc_channel = ADC0_SC1A & ADC_SC1_ADCH(31);
+
+    for (int k = 0; k <= this->_max_lag; k++) {
+        this->_history[k] = 0;
+        this->_correlation[k] = 0;
+    }
+
+    // Nearest power of two to the time constant in samples.
+    float tau_samples = COUPLING_TAU_MS * 1e-3 * this->_rate_hz;
+    this->_shift = 0;
+    while ( (1 << (this->_shift + 1)) <= tau_samples && this->_shift < 14 ) {
+        this->_shift++;
+    }
+
+    this->_conversion_command = this->_command;
+    ADC0_SC1A = this->_adc_channel;
+    coupling_timer.begin(this->_sample, 1e6 / this->_rate_hz);
+}
+
+
+
+void
+CouplingMonitor::command(float command_velocity) {
+
+    if (command_velocity > 32767) command_velocity = 32767;
+    if (command_velocity < -32767) command_velocity = -32767;
+    this->_command = (int16_t) command_velocity;
+}
+
+
+
+void
+CouplingMonitor::loop() {
+
+    // Process everything the timer has sampled since the last call.
+    while (this->_tail != this->_head) {
+        uint32_t i = this->_tail & (this->_queue_length - 1);
+        this->_process(this->_queue_cmd[i], this->_queue_act[i]);
+        this->_tail++;
+    }
+
+    this->lag_ms = 1e3 * this->_lag / (float) this->_rate_hz;
+    this->error = this->_error_acc / (float) (1 << this->_shift);
+
+    bool fault = (this->lag_ms > this->_lag_limit_ms) || (this->error > this->_error_limit);
+    if (fault != this->fault) {
+        digitalWrite(COUPLING_FAULT_PIN, fault ? HIGH : LOW);
+        this->fault = fault;
+    }
+}
+
+CouplingMonitor coupling = CouplingMonitor();
@@ -0,0 +1,103 @@
+#ifndef COUPLING_MONITOR_H
+#define COUPLING_MONITOR_H
+
+#include "options.h"
+
+/*!
+    Compares the velocity commanded by the Teensy with the Soloist's analog velocity tracking output.
+
+    The tracking voltage and the commanded velocity are sampled together at a fixed rate on a hardware timer. Each tick
+    reads the ADC conversion started on the previous tick and starts the next one, so the interrupt never waits on the ADC.
+    In loop(), a running cross-correlation over lags 0..::_max_lag estimates the lag between command and stage,
+    and a running mean absolute error is computed at that lag. The fault pin is raised when either exceeds its limit.
+*/
+class CouplingMonitor {
+
+    public:
+        //! CouplingMonitor constructor
+        CouplingMonitor();
+
+        //! Setup the analog input and fault pins and start sampling.
+        void setup ();
+
+        /*! Set the velocity currently commanded on the analog output. Sampled along with the tracking voltage.
+            \param command_velocity Commanded velocity (mm/s).
+        */
+        void command (float command_velocity);
+
+        //! Main loop method. Processes samples taken since the last call and updates the fault pin.
+        void loop ();
+
+        //! Current lag estimate between the commanded and actual velocity (ms).
+        float lag_ms = 0;
+
+        //! Running mean absolute velocity error at the estimated lag (mm/s).
+        float error = 0;
+
+        //! Whether the fault pin is currently raised.
+        bool fault = 0;
+
+        //! Number of samples dropped because loop() did not keep up.
+        volatile uint32_t overflows = 0;
+
+        //! Number of samples dropped because the ADC conversion was not finished by the next tick.
+        volatile uint32_t adc_misses = 0;
+
+    private:
+        //! Attached to the sampling timer. Reads the tracking voltage converted since the last tick and stores it with the command at that time.
+        static void _sample ();
+
+        /*! Update the running correlation and error with one sample pair.
+            \param cmd Commanded velocity (mm/s).
+            \param act Actual velocity (mm/s).
+        */
+        void _process (int16_t cmd, int16_t act);
+
+        //! Commanded velocity, read by the sampling interrupt (mm/s).
+        volatile int16_t _command = 0;
+
+        //! Commanded velocity when the conversion in progress was started (mm/s).
+        volatile int16_t _conversion_command = 0;
+
+        //! ADC0 channel of COUPLING_AI_PIN, found in setup().
+        uint8_t _adc_channel = 0;
+
+        //! Samples waiting to be processed. Power of two.
+        static const int _queue_length = 64;
+        volatile int16_t _queue_cmd[_queue_length];
+        volatile int16_t _queue_act[_queue_length];
+        volatile uint32_t _head = 0;
+        uint32_t _tail = 0;
+
+        //! Longest lag searched (samples).
+        static const int _max_lag = COUPLING_MAX_LAG;
+
+        //! Recent commanded velocities, indexed by lag.
+        int16_t _history[_max_lag + 1];
+        int _history_idx = 0;
+
+        //! Running products of the command at each lag with the actual velocity.
+        int32_t _correlation[_max_lag + 1];
+
+        //! Running mean absolute error (mm/s) scaled by 2^::_shift.
+        int32_t _error_acc = 0;
+
+        //! Lag (samples) with the largest correlation.
+        int _lag = 0;
+
+        //! Exponential averaging factor is 2^-_shift, chosen in setup() from COUPLING_TAU_MS.
+        int _shift = 0;
+
+        //! Correlation below which the stage is treated as stationary and lag is not updated ((mm/s)^2).
+        const int32_t _min_correlation = COUPLING_MIN_SPEED * COUPLING_MIN_SPEED;
+
+        const uint32_t _rate_hz = COUPLING_RATE_HZ;
+        const float _ai_offset = COUPLING_AI_OFFSET;
+        const float _mm_s_per_volt = COUPLING_MM_S_PER_VOLT;
+        const float _lag_limit_ms = COUPLING_LAG_LIMIT_MS;
+        const float _error_limit = COUPLING_ERROR_LIMIT;
+};
+
+extern CouplingMonitor coupling;
+
+#endif  /* COUPLING_MONITOR_H */
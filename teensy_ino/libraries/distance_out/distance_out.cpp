@@ -0,0 +1,57 @@
+#include <math.h>
+#include "Arduino.h"
+#include "distance_out.h"
+#include "options.h"
+
+
+
+DistanceOut::DistanceOut() {
+}
+
+
+
+uint16_t
+DistanceOut::_mm_to_bits(float distance_mm) {
+
+    float range = this->_max_mm - this->_min_mm;
+    float x = distance_mm - this->_min_mm;
+
+    if (this->_wrap) {
+        x = fmodf(x, range);
+        if (x < 0) x += range;
+    } else {
+        if (x < 0) x = 0;
+        if (x > range) x = range;
+    }
+
+    return (uint16_t) (x * this->_max_bits / range);
+}
+
+
+
+void
+DistanceOut::setup() {
+
+    // Both the DAC and PWM are written as 12-bit values.
+    analogWriteResolution(12);
+    if (!this->_dac) {
+        analogWriteFrequency(DISTANCE_PIN, DISTANCE_PWM_HZ);
+    }
+
+    // PWM is 0-3.3V full scale, as is the DAC with the default reference.
+    this->_max_bits = MAX_DAC_BITS * DISTANCE_MAX_VOLTS / MAX_DAC_VOLTS;
+
+    this->loop(0);
+}
+
+
+
+void
+DistanceOut::loop(float distance_mm) {
+
+    uint16_t bits = this->_mm_to_bits(distance_mm);
+    if (bits != this->_last_bits) {
+        analogWrite(DISTANCE_PIN, bits);
+        this->_last_bits = bits;
+    }
+}
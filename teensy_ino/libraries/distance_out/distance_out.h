@@ -0,0 +1,50 @@
+#ifndef DISTANCE_OUT_H
+#define DISTANCE_OUT_H
+
+#include <stdint.h>
+#include "options.h"
+
+/*!
+    Secondary analog output carrying the distance travelled since the last reset.
+
+    Uses the second DAC on boards which have one, otherwise PWM on ::DISTANCE_PIN, which must be followed by an RC low-pass filter.
+    Distance between ::DISTANCE_MIN_MM and ::DISTANCE_MAX_MM is mapped linearly onto 0 to ::DISTANCE_MAX_VOLTS.
+*/
+class DistanceOut {
+
+    public:
+        //! DistanceOut constructor
+        DistanceOut();
+
+        //! Setup the output pin and write zero distance.
+        void setup ();
+
+        /*! Write the distance to the output if it has changed by at least one output step.
+            \param distance_mm Distance since the last reset (mm).
+        */
+        void loop (float distance_mm);
+
+    private:
+        /*! Map a distance onto an output code, wrapping or clamping at the ends of the range.
+            \param distance_mm Distance (mm).
+        */
+        uint16_t _mm_to_bits (float distance_mm);
+
+        //! Whether the pin is a DAC (otherwise PWM).
+        const bool _dac = DISTANCE_DAC;
+
+        //! Whether distances outside the range wrap around (otherwise they clamp).
+        const bool _wrap = DISTANCE_WRAP;
+
+        const float _min_mm = DISTANCE_MIN_MM;
+        const float _max_mm = DISTANCE_MAX_MM;
+
+        //! Output code at ::_max_mm.
+        float _max_bits;
+
+        //! Last code written, to avoid rewriting unchanged values.
+        int32_t _last_bits = -1;
+};
+
+
+#endif  /* DISTANCE_OUT_H */
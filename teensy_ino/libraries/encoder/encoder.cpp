@@ -1,6 +1,21 @@
+#include <math.h>
 #include "Arduino.h"
 #include "encoder.h"
 #include "options.h"
+#include "timebase.h"
+
+
+
+// 4x state table, indexed by (previous state << 2) | new state, where state = (A << 1) | B.
+//  Forward is 00 -> 10 -> 11 -> 01 -> 00 (A rises while B is low).
+//  1 forwards, -1 backwards, 0 no change, QUAD_INVALID both pins changed.
+#define QUAD_INVALID 2
+const int8_t Encoder::_quad_table[16] = {
+     0, -1,  1,  QUAD_INVALID,
+     1,  0,  QUAD_INVALID, -1,
+    -1,  QUAD_INVALID,  0,  1,
+     QUAD_INVALID,  1, -1,  0
+};
 
 
 
@@ -9,54 +24,85 @@ Encoder::Encoder() {
 
 
 
-void
+FASTRUN void
 Encoder::_read() {
 
     // Read the current state of pins A and B.
     // Need to do this to determine whether encoder is moving forward or backward.
     this->_a_state = digitalReadFast(ENC_A_PIN);
     this->_b_state = digitalReadFast(ENC_B_PIN);
+
+    // Time of this edge.
+    this->_current_cycles = timebase.read_cycles();
 }
 
 
 
-void
+FASTRUN int
+Encoder::_edge_direction() {
+
+    // Direction implied by the current edge and the state of the other pin.
+    if ( this->_a_state == this->_b_state ) {
+        return ( this->_current_pin == ENC_A_PIN ) ? BACKWARDS : FORWARDS;
+    }
+    return ( this->_current_pin == ENC_A_PIN ) ? FORWARDS : BACKWARDS;
+}
+
+
+
+FASTRUN bool
+Encoder::_validate() {
+
+    // The pin which fired on RISING should still be high, otherwise the edge
+    //  was a spike shorter than the interrupt latency.
+    int level = ( this->_current_pin == ENC_A_PIN ) ? this->_a_state : this->_b_state;
+    if ( level == LOW ) {
+        this->rejected_level++;
+        return false;
+    }
+
+    // Edges closer together than is physically possible are bounce or EMI.
+    if ( (this->_current_cycles - this->_previous_cycles) < this->_min_edge_cycles ) {
+        this->rejected_interval++;
+        return false;
+    }
+
+    // With both pins, A and B must alternate unless the direction reverses.
+    //  A repeated edge on the same pin in the same direction means that pin
+    //  chattered while the other stayed still, so no distance was travelled.
+    if ( this->_dual_trigger && this->_current_pin == this->_previous_pin
+            && this->_edge_direction() == this->_previous_direction ) {
+        this->rejected_sequence++;
+        return false;
+    }
+
+    return true;
+}
+
+
+
+FASTRUN void
 Encoder::_delta_t() {
 
     // Calculate how long has it been since the previous interrupt.
-    this->_current_usecs = micros();
-    this->_delta_usecs = this->_current_usecs - this->_previous_usecs;
-    this->_previous_usecs = this->_current_usecs;
+    this->_delta_usecs = timebase.cycles_to_us(this->_current_cycles - this->_previous_cycles);
+    this->_previous_cycles = this->_current_cycles;
 }
 
 
 
-void
+FASTRUN void
 Encoder::_direction() {
 
     // Calculate the direction in which the encoder is travelling.
-    if ( this->_a_state == this->_b_state ) {
-        if ( this->_current_pin == ENC_A_PIN ) {
-            this->_current_direction = BACKWARDS;
-        }
-        if ( this->_current_pin == ENC_B_PIN ) {
-            this->_current_direction = FORWARDS;
-        }
-    } else {
-        if ( this->_current_pin == ENC_A_PIN ) {
-            this->_current_direction = FORWARDS;
-        }
-        if ( this->_current_pin == ENC_B_PIN ) {
-            this->_current_direction = BACKWARDS;
-        }
-    }
+    this->_current_direction = this->_edge_direction();
     this->_direction_change = ( this->_current_direction != this->_previous_direction );
     this->_previous_direction = this->_current_direction;
 }
 
 
 
-void
+FASTRUN void
 Encoder::_velocity() {
 
     // Determine the distance the encoder has travelled.
@@ -92,6 +138,7 @@ Encoder::_velocity() {
     // Do the velocity calculation.
     float t = (float) this->_delta_usecs;
     this->current_velocity = (float) this->_delta_distance / t; // this->delta_usecs;
+    this->_accumulate();
     
     // Increment the distance depending on the protocol.
     if (this->_protocol == FORWARD_AND_BACKWARD) {
@@ -102,40 +149,195 @@ Encoder::_velocity() {
 }
 
 
-void
+FASTRUN void
+Encoder::_velocity_4x() {
+
+    // Each transition crosses one of the four segments of an A-to-A cycle. The
+    //  segment is named by the state it ends in when travelling forwards.
+    //  Unlike rising edges only, a reversal crosses back over a real segment,
+    //  so its distance counts and undoes the previous transition.
+    int segment = ( this->_current_direction == FORWARDS ) ? this->_current_state : this->_previous_state;
+    this->_delta_distance = this->_current_direction * this->_quad_nm[segment];
+
+    float t = (float) this->_delta_usecs;
+    this->current_velocity = (float) this->_delta_distance / t;
+    this->_accumulate();
+
+    // Increment the distance depending on the protocol.
+    if (this->_protocol == FORWARD_AND_BACKWARD) {
+        this->_increment_distance();
+    } else if (this->current_velocity > 0) {
+        this->_increment_distance();
+    }
+}
+
+
+
+FASTRUN void
+Encoder::_main_4x() {
+
+    this->_read();
+    this->_current_state = (this->_a_state << 1) | this->_b_state;
+    int8_t transition = this->_quad_table[(this->_previous_state << 2) | this->_current_state];
+
+    // The pin changed and changed back before we could read it.
+    if ( transition == 0 ) {
+        if ( this->_glitch_reject ) this->rejected_level++;
+        return;
+    }
+
+    // Both pins changed, so we missed an edge. Resynchronise without moving.
+    if ( transition == QUAD_INVALID ) {
+        this->rejected_sequence++;
+        this->_previous_state = this->_current_state;
+        return;
+    }
+
+    // Edges closer together than is physically possible are bounce or EMI.
+    if ( this->_glitch_reject && (this->_current_cycles - this->_previous_cycles) < this->_min_edge_cycles ) {
+        this->rejected_interval++;
+        return;
+    }
+
+    this->_delta_t();
+    this->_current_direction = transition;
+    this->_direction_change = ( this->_current_direction != this->_previous_direction );
+    this->_previous_direction = this->_current_direction;
+    this->_velocity_4x();
+    this->_previous_state = this->_current_state;
+}
+
+
+
+FASTRUN void
 Encoder::_increment_distance() {
     this->total_distance += this->_delta_distance*1E-6;
 }
 
 
-void
+
+FASTRUN void
+Encoder::_accumulate() {
+
+    // Totals in both directions, whatever the protocol, for SessionStats.
+    if (this->_delta_distance > 0) {
+        this->forward_nm += (uint64_t) (this->_delta_distance + 0.5f);
+    } else {
+        this->backward_nm += (uint64_t) (-this->_delta_distance + 0.5f);
+    }
+    if (this->_direction_change) {
+        this->reversals++;
+    }
+    this->edges++;
+}
+
+
+FASTRUN void
 Encoder::_main() {
 
     // Every interrupt runs these steps.
     this->_read();
+
+    // Drop the edge entirely if it fails validation, so that neither its time
+    //  nor its direction affect the next real edge.
+    if ( this->_glitch_reject && !this->_validate() ) {
+        return;
+    }
+
     this->_delta_t();
     this->_direction();
     this->_velocity();
+    this->_previous_pin = this->_current_pin;
 }
 
 
 
-void
+FASTRUN void
 Encoder::_interrupt_a() {
 
     // We have received signal on A.
+    uint32_t entry = ARM_DWT_CYCCNT;
     enc._current_pin = 0;
     enc._main();
+    enc._isr_stats(entry);
 }
 
 
 
-void
+FASTRUN void
 Encoder::_interrupt_b() {
 
     // We have received signal on B.
+    uint32_t entry = ARM_DWT_CYCCNT;
     enc._current_pin = 1;
     enc._main();
+    enc._isr_stats(entry);
+}
+
+
+
+FASTRUN void
+Encoder::_interrupt_quad() {
+
+    // We have received a change on A or B.
+    uint32_t entry = ARM_DWT_CYCCNT;
+    enc._main_4x();
+    enc._isr_stats(entry);
+}
+
+
+
+FASTRUN void
+Encoder::_interrupt_port() {
+
+    // Our own handler for the encoder port, replacing attachInterrupt's dispatch.
+    //  Only the encoder pins are serviced, so no other pin on this port may use attachInterrupt.
+    uint32_t entry = ARM_DWT_CYCCNT;
+    uint32_t flags = *enc._isfr;
+    *enc._isfr = flags & (enc._a_mask | enc._b_mask);
+
+    if ( enc._quadrature_4x ) {
+        // One decode covers both pins, as it reads the state of each.
+        if ( flags & (enc._a_mask | enc._b_mask) ) enc._main_4x();
+    } else {
+        if ( flags & enc._a_mask ) {
+            enc._current_pin = ENC_A_PIN;
+            enc._main();
+        }
+        if ( flags & enc._b_mask ) {
+            enc._current_pin = ENC_B_PIN;
+            enc._main();
+        }
+    }
+    enc._isr_stats(entry);
+}
+
+
+
+FASTRUN void
+Encoder::_isr_stats(uint32_t entry) {
+
+    uint32_t cycles = ARM_DWT_CYCCNT - entry;
+    this->isr_entry_cycles = entry;
+    this->isr_count++;
+    if (cycles > this->isr_max_cycles) this->isr_max_cycles = cycles;
+}
+
+
+
+bool
+Encoder::_port_of(int pin, volatile uint32_t **isfr, uint32_t *mask, int *irq) {
+
+    // The PORTx_PCRn registers are 4 bytes apart, and the ports 0x1000 bytes apart
+    //  with the interrupt status flags at offset 0xA0, in the order of IRQ_PORTA..IRQ_PORTE.
+    uint32_t pcr = (uint32_t) portConfigRegister(pin);
+    uint32_t port = (pcr - (uint32_t) &PORTA_PCR0) >> 12;
+    if (port > 4) return false;
+
+    *isfr = (volatile uint32_t *) ((pcr & ~0xFFF) + 0xA0);
+    *mask = 1u << ((pcr & 0xFFF) >> 2);
+    *irq = IRQ_PORTA + port;
+    return true;
 }
 
 
@@ -147,14 +349,57 @@ Encoder::setup(int protocol) {
     pinMode(ENC_A_PIN, INPUT_PULLUP);
     pinMode(ENC_B_PIN, INPUT_PULLUP);
     
-    // Attach interrupt signals to respective functions.
-    attachInterrupt(ENC_A_PIN, this->_interrupt_a, RISING);
-    if ( this->_dual_trigger ) {
-        attachInterrupt(ENC_B_PIN, this->_interrupt_b, RISING);
+    // Distance covered by each of the four transitions, indexed by the state they end in going forwards.
+    this->_quad_nm[2] = (1 - QUAD_B_RISE - QUAD_A_FALL - QUAD_B_FALL) * this->_nm_per_count;
+    this->_quad_nm[3] = QUAD_B_RISE * this->_nm_per_count;
+    this->_quad_nm[1] = QUAD_A_FALL * this->_nm_per_count;
+    this->_quad_nm[0] = QUAD_B_FALL * this->_nm_per_count;
+    
+    // Attach interrupt signals to respective functions. This also sets the
+    //  edge each pin interrupts on, which the fast handler relies on.
+    if ( this->_quadrature_4x ) {
+        this->_previous_state = (digitalReadFast(ENC_A_PIN) << 1) | digitalReadFast(ENC_B_PIN);
+        attachInterrupt(ENC_A_PIN, this->_interrupt_quad, CHANGE);
+        attachInterrupt(ENC_B_PIN, this->_interrupt_quad, CHANGE);
+    } else {
+        attachInterrupt(ENC_A_PIN, this->_interrupt_a, RISING);
+        if ( this->_dual_trigger ) {
+            attachInterrupt(ENC_B_PIN, this->_interrupt_b, RISING);
+        }
+    }
+
+    // Take over the port's vector with our handler in RAM, at a priority above USB and the timers.
+    //  Only possible when both pins share a port.
+    volatile uint32_t *isfr_b;
+    int irq_a, irq_b;
+    if ( this->_fast_isr
+            && this->_port_of(ENC_A_PIN, &this->_isfr, &this->_a_mask, &irq_a)
+            && this->_port_of(ENC_B_PIN, &isfr_b, &this->_b_mask, &irq_b)
+            && irq_a == irq_b ) {
+        if ( !this->_quadrature_4x && !this->_dual_trigger ) this->_b_mask = 0;
+        attachInterruptVector((IRQ_NUMBER_t) irq_a, this->_interrupt_port);
+        NVIC_SET_PRIORITY(irq_a, ENCODER_IRQ_PRIORITY);
+        this->fast_isr_active = 1;
     }
     
+    // Shortest possible interval between two real edges, given the smallest
+    //  distance between edges and the fastest plausible velocity (nm / (mm/s) = us).
+    //  The longest distance bounds the velocity while waiting for an edge (see loop()).
+    float min_nm = this->_nm_per_count;
+    this->_max_edge_nm = this->_nm_per_count;
+    if ( this->_quadrature_4x ) {
+        min_nm = min(min(this->_quad_nm[0], this->_quad_nm[1]), min(this->_quad_nm[2], this->_quad_nm[3]));
+        this->_max_edge_nm = max(max(this->_quad_nm[0], this->_quad_nm[1]), max(this->_quad_nm[2], this->_quad_nm[3]));
+    } else if ( this->_dual_trigger ) {
+        min_nm = min(min(this->_b_to_a_rising_nm, this->_a_to_b_rising_nm),
+                     min(this->_b_to_a_rising_nm_back, this->_a_to_b_rising_nm_back));
+        this->_max_edge_nm = max(max(this->_b_to_a_rising_nm, this->_a_to_b_rising_nm),
+                                 max(this->_b_to_a_rising_nm_back, this->_a_to_b_rising_nm_back));
+    }
+    this->_min_edge_cycles = (uint64_t) (timebase.cycles_per_us * min_nm / (this->_glitch_velocity_factor * MAX_VELOCITY));
+
     // Set some vars.
-    this->_previous_usecs = micros();
+    this->_previous_cycles = timebase.read_cycles();
     this->_protocol = protocol;
 }
 
@@ -163,11 +408,26 @@ Encoder::setup(int protocol) {
 void
 Encoder::loop() {
 
+    // An edge after this iteration's time sample can make last > now.
     noInterrupts();
-    uint32_t now = micros();
-    uint32_t last_u = this->_previous_usecs;
-    if ((now > last_u) && ((now - last_u) > this->_timeout)) {
-        this->current_velocity = 0;
+    uint64_t now = timebase.cycles();
+    uint64_t last = this->_previous_cycles;
+    if (now > last) {
+        uint32_t since = timebase.cycles_to_us(now - last);
+
+        if (since > this->_timeout) {
+            // Backstop: no edge for a long time.
+            this->current_velocity = 0;
+        } else if (this->_stop_decay && since > this->_delta_usecs) {
+            // No edge yet, and it is later than the last interval. The encoder can
+            //  be travelling no faster than the longest edge distance over the time
+            //  since the last edge, so velocity decays towards zero as we keep waiting.
+            //  With unequal edge distances (dual trigger) the next edge may be the
+            //  longer one, so bounding by the last edge would clip a steady velocity.
+            float bound = this->_max_edge_nm / (float) since;
+            if (this->current_velocity > bound) this->current_velocity = bound;
+            if (this->current_velocity < -bound) this->current_velocity = -bound;
+        }
     }
     interrupts();
 }
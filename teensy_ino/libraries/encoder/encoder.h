@@ -20,7 +20,7 @@ class Encoder {
         */
         void setup (int protocol);
 
-        //! Main loop method. Handles setting zero-velocity after timeout.
+        //! Main loop method. Bounds the velocity while waiting for the next edge and sets zero-velocity after timeout.
         void loop ();
 
         //! Current recorded velocity.
@@ -29,10 +29,50 @@ class Encoder {
         //! Total distance recorded.
         volatile float total_distance = 0;
 
+        //! Distance travelled forwards since setup (nm). Unlike ::total_distance, never reset.
+        //!  Kept in whole nm so that small edges still count once the total is large; read with interrupts off.
+        volatile uint64_t forward_nm = 0;
+
+        //! Distance travelled backwards since setup (nm, positive). Never reset.
+        volatile uint64_t backward_nm = 0;
+
+        //! Number of changes of direction since setup.
+        volatile uint32_t reversals = 0;
+
+        //! Number of accepted edges since setup.
+        volatile uint32_t edges = 0;
+
+        //! Number of edges rejected because the pin was no longer high when the interrupt ran.
+        volatile uint32_t rejected_level = 0;
+
+        //! Number of edges rejected for arriving sooner than ::_min_edge_cycles after the previous edge.
+        volatile uint32_t rejected_interval = 0;
+
+        //! Number of edges rejected for repeating on the same pin without a change of direction.
+        volatile uint32_t rejected_sequence = 0;
+
+        //! Whether the encoder port is serviced by ::_interrupt_port (see ENCODER_FAST_ISR).
+        bool fast_isr_active = 0;
+
+        //! Number of encoder interrupts handled.
+        volatile uint32_t isr_count = 0;
+
+        //! Cycle counter (ARM_DWT_CYCCNT) on entry to the last encoder interrupt.
+        volatile uint32_t isr_entry_cycles = 0;
+
+        //! Longest encoder interrupt, entry to exit (cycles).
+        volatile uint32_t isr_max_cycles = 0;
+
     private:
         //! Read the current state of pins A and B. Required to determine if encoder is moving forward or backward.
         void _read ();
 
+        //! Direction implied by the current edge and the state of the other pin.
+        int _edge_direction ();
+
+        //! Check the edge is physically plausible. Increments the matching rejection counter if not.
+        bool _validate ();
+
         //! Calculate time since previous interrupt.
         void _delta_t ();
 
@@ -42,10 +82,19 @@ class Encoder {
         //! Calculate the ::_delta_distance and ::current_velocity. Increment ::total_distance.
         void _velocity();
 
+        //! Calculate the ::_delta_distance and ::current_velocity from a 4x transition. Increment ::total_distance.
+        void _velocity_4x ();
+
+        //! Run on pin changes in 4x mode. Decodes the transition with ::_quad_table.
+        void _main_4x ();
+
         //! Increments the ::total_distance with the current ::_delta_distance.
         void _increment_distance();
 
-        //! Run on pin interrupts. Performs _read(), _delta_t(), _direction(), _velocity().
+        //! Adds the current ::_delta_distance to ::forward_nm or ::backward_nm and counts edges and reversals.
+        void _accumulate ();
+
+        //! Run on pin interrupts. Performs _read(), _validate(), _delta_t(), _direction(), _velocity().
         void _main ();
 
         //! Attached to interrupt for ENC_A_PIN. Sets the ::_current_pin and runs main()
@@ -54,16 +103,46 @@ class Encoder {
         //! Attached to interrupt for ENC_B_PIN. Sets the ::_current_pin and runs main()
         static void _interrupt_b();
 
+        //! Attached to CHANGE interrupts on both pins in 4x mode. Runs _main_4x()
+        static void _interrupt_quad();
+
+        //! Replaces the port interrupt vector with ENCODER_FAST_ISR. Clears the pin flags and runs main() or _main_4x().
+        static void _interrupt_port();
+
+        /*! Update the interrupt counters on exit from an interrupt.
+            \param entry ARM_DWT_CYCCNT on entry.
+        */
+        void _isr_stats (uint32_t entry);
+
+        /*! Find the interrupt status register, bit and IRQ of a pin.
+            \param pin Pin number.
+            \param isfr Set to the PORTx_ISFR register of the pin's port.
+            \param mask Set to the pin's bit in isfr.
+            \param irq Set to the IRQ of the pin's port.
+        */
+        bool _port_of (int pin, volatile uint32_t **isfr, uint32_t *mask, int *irq);
+
         //! The protocol being run.
         int _protocol;
 
-        volatile uint32_t _previous_usecs;
-        uint32_t _current_usecs;
+        //! Timebase cycle count of the previous accepted edge.
+        volatile uint64_t _previous_cycles;
+
+        //! Timebase cycle count of the current edge.
+        uint64_t _current_cycles;
+
+        //! Time since the previous accepted edge (microseconds).
         uint32_t _delta_usecs;
 
         //! If encoder doesn't move, time to take before setting velocity to 0.
         const uint32_t _timeout = TIMEOUT;
 
+        //! Whether to bound velocity by ::_max_edge_nm / time since last edge while waiting for an edge.
+        const bool _stop_decay = STOP_DECAY;
+
+        //! Longest distance between two edges (nm), computed in setup().
+        float _max_edge_nm = NM_PER_COUNT;
+
         //! Distance in nm traveled by treadmill on each tick.
         const float _nm_per_count = NM_PER_COUNT;
 
@@ -81,9 +160,40 @@ class Encoder {
         //! Whether or not to use encoder ticks A and B to calculate velocity.
         const bool _dual_trigger = DUAL_TRIGGER;
 
+        //! Whether to decode every transition on A and B rather than rising edges.
+        const bool _quadrature_4x = QUADRATURE_4X;
+
+        //! Transition lookup for 4x decoding.
+        static const int8_t _quad_table[16];
+
+        //! Distance (nm) of the transition into each state going forwards, state = (A << 1) | B.
+        float _quad_nm[4];
+
+        //! State of A and B at the current and previous accepted transition.
+        int _current_state = 0;
+        int _previous_state = 0;
+
+        //! Whether to service the encoder port with ::_interrupt_port, from RAM and at ENCODER_IRQ_PRIORITY.
+        const bool _fast_isr = ENCODER_FAST_ISR;
+
+        //! Interrupt status flags of the encoder port, and the bits of each pin.
+        volatile uint32_t *_isfr = 0;
+        uint32_t _a_mask = 0;
+        uint32_t _b_mask = 0;
+
+        //! Whether to validate edges before using them.
+        const bool _glitch_reject = GLITCH_REJECT;
+
+        //! Multiple of MAX_VELOCITY above which an edge interval is considered impossible.
+        const float _glitch_velocity_factor = GLITCH_VELOCITY_FACTOR;
+
+        //! Minimum interval between edges (cycles), computed in setup().
+        uint64_t _min_edge_cycles = 0;
+
         int _a_state;
         int _b_state;
         int _current_pin;
+        int _previous_pin = -1;
 
         int _current_direction = FORWARDS;
         int _previous_direction = FORWARDS;
@@ -2,6 +2,7 @@
 #include "Arduino.h"
 #include "gain_control.h"
 #include "trigger_input.h"
+#include "timebase.h"
 #include "options.h"
 
 
@@ -29,45 +30,71 @@ GainControl::setup() {
 
 
 void
-GainControl::loop() {
+GainControl::_start(float target, float full_dt) {
+	
+	this->_time_started = timebase.now_ms();
+	this->_initial_value = this->value;
+	this->_target = target;
+	this->_dvalue = this->_target - this->_initial_value;
+	this->_full_dt = full_dt;
+}
+
+
+
+void
+GainControl::set(float target, float ramp_ms) {
+	
+	if (ramp_ms < 0) ramp_ms = 0;
+	this->_start(target, ramp_ms);
+}
+
+
+
+void
+GainControl::update() {
 	
 	float dt = 0;
+	uint64_t now = timebase.now_ms();
+	
+	if ((now - this->_time_started) < this->_full_dt) {
+		dt = (float) (now - this->_time_started);
+		this->value = this->_initial_value + dt * (this->_dvalue/this->_full_dt);
+	} else {
+		this->value = this->_target;
+	}
+}
+
+
+
+void
+GainControl::loop() {
+	
+	float target = this->_target;
 	
 	gain_up.loop();
 	gain_down.loop();
 	
 	if ( (gain_up.delta_state != 0) | (gain_down.delta_state != 0) ) {
 		
-		this->_time_started = millis();
-		this->_initial_value = this->value;
-		
 		if ( (gain_up.current_state == HIGH) & (gain_down.current_state == HIGH) ) {
-			this->_target = 1;
-			digitalWrite(GAIN_REPORT_PIN, HIGH)
+			target = 1;
+			digitalWrite(GAIN_REPORT_PIN, HIGH);
 		}
 		else if ( (gain_up.current_state == HIGH) & (gain_down.current_state == LOW) ) {
-			this->_target = GAIN_UP_VAL;
+			target = GAIN_UP_VAL;
 			digitalWrite(GAIN_REPORT_PIN, HIGH);
 		}
 		else if ( (gain_up.current_state == LOW) & (gain_down.current_state == HIGH) ) {
-			this->_target = GAIN_DOWN_VAL;
+			target = GAIN_DOWN_VAL;
 			digitalWrite(GAIN_REPORT_PIN, HIGH);
 		}
 		else if ( (gain_up.current_state == LOW) & (gain_down.current_state == LOW) ) {	
-			this->_target = 1;
+			target = 1;
 			digitalWrite(GAIN_REPORT_PIN, LOW);
 		}
 		
-		this->_dvalue = this->_target - this->_initial_value;
-		this->_full_dt = fabs(this->_dvalue) * MS_PER_UNIT_GAIN;
+		this->_start(target, fabs(target - this->value) * MS_PER_UNIT_GAIN);
 	}
 	
-	
-	if ((millis() - this->_time_started) < this->_full_dt) {
-		dt = (float) (millis() - this->_time_started);
-		this->value = this->_initial_value + dt * (this->_dvalue/this->_full_dt);
-	} else {
-		this->value = this->_target;
-	}
-    
+	this->update();
 }
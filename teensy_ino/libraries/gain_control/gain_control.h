@@ -1,6 +1,7 @@
 #ifndef GAIN_CONTROL_H
 #define GAIN_CONTROL_H
 
+#include <stdint.h>
 #include "options.h"
 
 /*!
@@ -18,18 +19,30 @@ class GainControl {
 		//! Main loop method. Detects trigger inputs, adjusts gain and writes to gain report pin.
         void loop ();
         
+		/*! Ramp linearly to a new gain, e.g. on a host command. Call update() each loop.
+			\param target Gain to ramp to.
+			\param ramp_ms Duration of the ramp in ms, 0 to step.
+		*/
+        void set (float target, float ramp_ms);
+        
+		//! Advance the current ramp and update ::value. Called by loop(), or on its own when the pins are not used.
+        void update ();
+        
         float value = 1;
 
     private:
     	
-    	void _start();
-    	void _stop();
+		/*! Start a ramp from the current ::value.
+			\param target Gain to ramp to.
+			\param full_dt Duration of the ramp in ms.
+		*/
+    	void _start(float target, float full_dt);
     	
-    	float _target;
-    	float _initial_value;
-    	int _time_started;
-    	float _dvalue;
-    	float _full_dt;
+    	float _target = 1;
+    	float _initial_value = 1;
+    	uint64_t _time_started = 0;
+    	float _dvalue = 0;
+    	float _full_dt = 0;
 };
 
 
@@ -0,0 +1,75 @@
+#include "Arduino.h"
+#include "gain_map.h"
+#include "options.h"
+
+
+
+GainMap::GainMap() {
+    this->_tables[0].n = 0;
+    this->_tables[1].n = 0;
+}
+
+
+
+void
+GainMap::clear() {
+
+    this->_tables[1 - this->_active].n = 0;
+}
+
+
+
+bool
+GainMap::add(float position_mm, float gain) {
+
+    Table *t = &this->_tables[1 - this->_active];
+
+    if (t->n >= GAIN_MAP_POINTS) return false;
+    if (t->n > 0 && position_mm < t->position[t->n - 1]) return false;
+
+    t->position[t->n] = position_mm;
+    t->gain[t->n] = gain;
+    t->n++;
+    return true;
+}
+
+
+
+void
+GainMap::apply() {
+
+    this->_active = 1 - this->_active;
+    this->_segment = 0;
+    this->clear();
+}
+
+
+
+int
+GainMap::n_points() {
+
+    return this->_tables[this->_active].n;
+}
+
+
+
+float
+GainMap::gain(float position_mm) {
+
+    Table *t = &this->_tables[this->_active];
+
+    if (t->n == 0) return 1;
+    if (position_mm <= t->position[0]) return t->gain[0];
+    if (position_mm >= t->position[t->n - 1]) return t->gain[t->n - 1];
+
+    // Find i with position[i] <= position_mm < position[i + 1], starting from the last segment.
+    int i = this->_segment;
+    if (i > t->n - 2) i = t->n - 2;
+    while (position_mm < t->position[i]) i--;
+    while (position_mm >= t->position[i + 1]) i++;
+    this->_segment = i;
+
+    // position[i + 1] > position_mm >= position[i], so the segment has non-zero length.
+    float frac = (position_mm - t->position[i]) / (t->position[i + 1] - t->position[i]);
+    return t->gain[i] + frac * (t->gain[i + 1] - t->gain[i]);
+}
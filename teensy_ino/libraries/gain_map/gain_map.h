@@ -0,0 +1,56 @@
+#ifndef GAIN_MAP_H
+#define GAIN_MAP_H
+
+#include <stdint.h>
+#include "options.h"
+
+/*!
+    Gain as a function of position, e.g. for a virtual corridor.
+
+    A table of up to ::GAIN_MAP_POINTS (position, gain) points is interpolated linearly, and held at the end values outside it.
+    Points are loaded into a pending table with add() while the active table stays in use, and apply() swaps them in at once.
+    Two points at the same position give a step. With no points applied the gain is 1.
+*/
+class GainMap {
+
+    public:
+        //! GainMap constructor
+        GainMap();
+
+        //! Empty the pending table.
+        void clear ();
+
+        /*! Append a point to the pending table. Returns false if the table is full or the position is lower than the last point.
+            \param position_mm Position (mm), as Encoder::total_distance.
+            \param gain Gain at this position.
+        */
+        bool add (float position_mm, float gain);
+
+        //! Make the pending table active. The pending table starts again empty.
+        void apply ();
+
+        /*! Gain at a position.
+            \param position_mm Position (mm).
+        */
+        float gain (float position_mm);
+
+        //! Number of points in the active table.
+        int n_points ();
+
+    private:
+        struct Table {
+            float position[GAIN_MAP_POINTS];
+            float gain[GAIN_MAP_POINTS];
+            int n;
+        };
+
+        //! Active and pending tables, swapped by apply().
+        Table _tables[2];
+        int _active = 0;
+
+        //! Segment used by the last call to gain(). Positions change slowly, so the search starts here.
+        int _segment = 0;
+};
+
+
+#endif  /* GAIN_MAP_H */
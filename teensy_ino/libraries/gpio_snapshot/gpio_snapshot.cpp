@@ -0,0 +1,67 @@
+#include "Arduino.h"
+#include "gpio_snapshot.h"
+
+
+// Input registers of ports A to E.
+static volatile uint32_t * const port_input_registers[] = {
+    &GPIOA_PDIR, &GPIOB_PDIR, &GPIOC_PDIR, &GPIOD_PDIR, &GPIOE_PDIR
+};
+
+
+
+GpioSnapshot::GpioSnapshot() {
+}
+
+
+
+void
+GpioSnapshot::watch(int pin) {
+
+    if (!this->_initialised) {
+        for (int i = 0; i < CORE_NUM_DIGITAL; i++) {
+            this->_pin_port[i] = -1;
+        }
+        this->_initialised = 1;
+    }
+
+    if (pin < 0 || pin >= CORE_NUM_DIGITAL) return;
+
+    // The core stores the bit-band alias of each pin's output register. The alias
+    //  offset / 4 is the bit index from the start of the peripheral region, which
+    //  gives back the port register and the bit within it.
+    uint32_t alias = (uint32_t) digital_pin_to_info_PGM[pin].reg;
+    uint32_t bit_index = (alias - 0x42000000) >> 2;
+    uint32_t reg = 0x40000000 + ((bit_index >> 5) << 2);
+    int port = (reg - (uint32_t) &GPIOA_PDOR) / 0x40;
+
+    this->_pin_port[pin] = port;
+    this->_pin_bit[pin] = bit_index & 31;
+    this->_port_mask |= (1 << port);
+
+    this->capture();
+}
+
+
+
+void
+GpioSnapshot::capture() {
+
+    for (int i = 0; i < this->_n_ports; i++) {
+        if (this->_port_mask & (1 << i)) {
+            this->_ports[i] = *port_input_registers[i];
+        }
+    }
+}
+
+
+
+int
+GpioSnapshot::read(int pin) {
+
+    if (!this->_initialised || pin < 0 || pin >= CORE_NUM_DIGITAL || this->_pin_port[pin] < 0) {
+        return digitalRead(pin);
+    }
+    return (this->_ports[this->_pin_port[pin]] >> this->_pin_bit[pin]) & 1;
+}
+
+GpioSnapshot gpio = GpioSnapshot();
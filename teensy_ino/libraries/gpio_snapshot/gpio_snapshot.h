@@ -0,0 +1,56 @@
+#ifndef GPIO_SNAPSHOT_H
+#define GPIO_SNAPSHOT_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+/*!
+    Reads the GPIO port input registers once per loop iteration into a snapshot.
+
+    Modules register their input pins with watch() in setup and read levels with read(), so that every module
+    sees the state of all pins at the same instant, at the cost of one register read per port instead of one
+    digitalRead() per pin.
+*/
+class GpioSnapshot {
+
+    public:
+        //! GpioSnapshot constructor
+        GpioSnapshot();
+
+        /*! Add a pin to the snapshot and take a fresh snapshot.
+            \param pin Digital pin number.
+        */
+        void watch (int pin);
+
+        //! Read the input register of every port with a watched pin. Call once at the start of each loop iteration.
+        void capture ();
+
+        /*! Level of a pin in the last snapshot. Falls back to digitalRead() for pins which are not watched.
+            \param pin Digital pin number.
+            \return HIGH or LOW
+        */
+        int read (int pin);
+
+    private:
+        //! Number of GPIO ports (A to E).
+        static const int _n_ports = 5;
+
+        //! Last value read from each port's input register.
+        uint32_t _ports[_n_ports];
+
+        //! Bit n set if port n has a watched pin.
+        uint8_t _port_mask = 0;
+
+        //! Port index of each pin, -1 if not watched.
+        int8_t _pin_port[CORE_NUM_DIGITAL];
+
+        //! Bit of each pin within its port.
+        uint8_t _pin_bit[CORE_NUM_DIGITAL];
+
+        //! Whether ::_pin_port has been initialised.
+        bool _initialised = 0;
+};
+
+extern GpioSnapshot gpio;
+
+#endif  /* GPIO_SNAPSHOT_H */
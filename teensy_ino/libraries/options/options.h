@@ -18,9 +18,28 @@
 // ENCODER
 #define DUAL_TRIGGER            1       // BOOLEAN,  whether or not to use encoder ticks A and B to calculate velocity
 #define TIMEOUT                 50000   // MICROSECONDS, if encoder doesn't move, time to wait before setting velocity to zero 
+#define STOP_DECAY              1       // BOOL, once the time since the last edge exceeds the last interval, bound velocity by edge distance / time since last edge
 #define NM_PER_COUNT            164381  // NM,  distance treadmill travels each tick
 #define PHASE_FACTOR            0.24625 // 0-1,  phase of distance from A to B relative to distance from A to A encoder tick - empirically determined
 #define PHASE_FACTOR_BACK       0.25    // 0-1,  phase of distance from B to A relative to distance from A to A encoder tick - empirically determined
+#define QUADRATURE_4X           0       // BOOL, decode every transition on A and B (ignores DUAL_TRIGGER)
+#define QUAD_B_RISE             PHASE_FACTOR // 0-1, fraction of the A-to-A distance from A rising to B rising
+#define QUAD_A_FALL             0.25    // 0-1, fraction of the A-to-A distance from B rising to A falling
+#define QUAD_B_FALL             0.25    // 0-1, fraction of the A-to-A distance from A falling to B falling (B falling to A rising is the remainder)
+#define GLITCH_REJECT           1       // BOOL, whether to reject encoder edges which are physically implausible
+#define GLITCH_VELOCITY_FACTOR  2       // multiple of MAX_VELOCITY, edges closer together than this velocity implies are rejected
+#define ENCODER_FAST_ISR        1       // BOOL, service the encoder port with our own handler in RAM instead of attachInterrupt's dispatch
+#define ENCODER_IRQ_PRIORITY    16      // 0-255 in steps of 16, lower is more urgent (USB is 112, IntervalTimer 128)
+
+// SCHEDULER
+#define OUTPUT_TASK_US          0       // MICROSECONDS, period of the velocity-to-DAC task (0 = every loop iteration)
+#define TRIGGER_INPUT_TASK_US   0       // MICROSECONDS, period of the trigger input (and gain input) polling, at the priority of the output
+#define ENCODER_TASK_US         250     // MICROSECONDS, period of the encoder stop decay and timeout check
+#define TRIGGER_OUTPUT_TASK_US  1000    // MICROSECONDS, period of the trigger output check
+#define COUPLING_TASK_US        5000    // MICROSECONDS, period of the coupling monitor processing
+#define COMMAND_TASK_US         250     // MICROSECONDS, period of the host command channel (resolution of scheduled commands)
+#define STATS_TASK_US           1000    // MICROSECONDS, period of the session statistics update
+#define SCOPE_SAMPLE_US         500     // MICROSECONDS, interval between capture samples (runs at the priority of the output)
 
 // PROTOCOLS
 #define FORWARD_ONLY            0
@@ -37,6 +56,69 @@
 // ANALOG OUTPUT
 #define MAX_DAC_VOLTS           3.3     // VOLTS, for converting to BITS
 #define MAX_DAC_BITS            4095    // 2^12-1,  we are writing 12-bit integers to analog output
+#define DAC_NOISE_SHAPING       0       // 0 = off, 1 = first-order, 2 = second-order noise shaping of the velocity output
+#define DAC_SHAPING_HZ          50000   // HZ, rate at which the noise-shaped output is written
+
+// DISTANCE OUTPUT
+#define DISTANCE_OUT            0       // BOOL, whether to output the distance since the last reset on a second analog output
+#if defined(__MK64FX512__) || defined(__MK66FX1M0__)
+#define DISTANCE_PIN            A22     // second DAC on Teensy 3.5/3.6
+#define DISTANCE_DAC            1
+#else
+#define DISTANCE_PIN            5       // PWM, needs an external RC low-pass filter
+#define DISTANCE_DAC            0
+#endif
+#define DISTANCE_PWM_HZ         11718.75 // HZ, fastest PWM frequency with 12-bit resolution at 48MHz bus clock
+#define DISTANCE_MIN_MM         BACKWARD_DISTANCE // MM, distance output as 0V
+#define DISTANCE_MAX_MM         FORWARD_DISTANCE  // MM, distance output as DISTANCE_MAX_VOLTS
+#define DISTANCE_MAX_VOLTS      3.3     // VOLTS, output at DISTANCE_MAX_MM
+#define DISTANCE_WRAP           0       // BOOL, 1 wraps distances outside the range around, 0 clamps them to the ends
+
+// WAVEFORM REPLAY
+#define WAVEFORM_RATE_HZ        20000   // HZ, rate at which streamed DAC codes are clocked out by DMA
+#define WAVEFORM_HALF_SAMPLES   512     // number of samples in each half of the ping-pong buffer
+
+// HOST COMMANDS
+#define COMMAND_CHANNEL         1       // BOOL, whether the controller accepts binary commands over USB serial
+#define COMMAND_QUEUE_LENGTH    8       // number of commands which can be scheduled for a future time
+#define COMMAND_REPLY_BYTES     128     // replies up to this long (e.g. the statistics) are copied, so that a resend repeats them
+
+// GAIN MAP
+#define GAIN_MAP                1       // BOOL, whether the controller multiplies the gain by a host-loaded function of distance
+#define GAIN_MAP_POINTS         32      // maximum number of points in the gain map
+
+// SESSION STATISTICS
+#define SESSION_STATS           1       // BOOL, whether the controller keeps running statistics of the treadmill for the host
+#define STATS_MOVING_MM_S       10      // MM/S, speed above which the treadmill counts as moving
+#define STATS_BIN_MM_S          50      // MM/S, width of each speed histogram bin
+#define STATS_BINS              16      // number of speed histogram bins, the last also counts faster speeds
+
+// SCOPE CAPTURE
+#define SCOPE                   1       // BOOL, whether the controller keeps a pre/post-trigger capture of its state
+#define SCOPE_SAMPLES           512     // number of samples kept (24 bytes each)
+#define SCOPE_POST_SAMPLES      128     // number of samples recorded after the trigger
+#define SCOPE_TRIGGERS          0x07    // trigger sources armed at startup: 0x01 trigger input, 0x02 reward, 0x04 disable, 0x08 velocity
+#define SCOPE_VELOCITY_MM_S     1500    // MM/S, encoder speed above which the velocity trigger source is set
+
+// SYNC PULSES
+#define SYNC_PULSE              0       // BOOL, whether to write coded sync pulses for alignment with the NI acquisition
+#define SYNC_PIN                4       // digital output carrying the sync pulses (record on a NI analog input)
+#define SYNC_PERIOD_US          1000000 // MICROSECONDS, interval between sync frames
+#define SYNC_TICK_US            1000    // MICROSECONDS, unit of pulse width, at least 2 NI samples
+#define SYNC_BITS               16      // bits of the frame number written in each frame
+
+// COUPLING MONITOR
+#define COUPLING_MONITOR        0       // BOOL, whether to compare the Soloist velocity tracking output with the commanded velocity
+#define COUPLING_AI_PIN         A10     // analog input pin receiving the (divided down) Soloist velocity tracking output
+#define COUPLING_FAULT_PIN      3       // digital output raised when coupling lag or error exceeds its limit
+#define COUPLING_RATE_HZ        2000    // HZ, rate at which the tracking output is sampled
+#define COUPLING_AI_OFFSET      1.65    // VOLTS, voltage on COUPLING_AI_PIN corresponding to zero stage velocity
+#define COUPLING_MM_S_PER_VOLT  1000    // MM/S, stage velocity per volt on COUPLING_AI_PIN (negative if the stage runs opposite to the command)
+#define COUPLING_MAX_LAG        40      // SAMPLES, longest lag searched by the cross-correlation
+#define COUPLING_TAU_MS         200     // MILLISECONDS, time constant of the running correlation and error
+#define COUPLING_MIN_SPEED      20      // MM/S, below this (rms) the stage is treated as stationary and the lag estimate is held
+#define COUPLING_LAG_LIMIT_MS   10      // MILLISECONDS, lag above which the fault pin is raised
+#define COUPLING_ERROR_LIMIT    50      // MM/S, mean absolute error above which the fault pin is raised
 
 // GAIN SETTINGS
 #define GAIN_UP_PIN 			6		// Reuse ZERO_POSITION_PIN
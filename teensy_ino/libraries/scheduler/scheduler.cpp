@@ -0,0 +1,109 @@
+#include "Arduino.h"
+#include "scheduler.h"
+#include "timebase.h"
+
+
+
+Scheduler::Scheduler() {
+}
+
+
+
+int
+Scheduler::add(TaskFunction fn, void *context, uint32_t period_us, uint8_t priority) {
+
+    if (this->_n_tasks >= this->max_tasks) return -1;
+
+    int idx = this->_n_tasks;
+    Task *task = &this->_tasks[idx];
+    task->fn = fn;
+    task->context = context;
+    task->period_us = period_us;
+    task->priority = priority;
+    task->next_us = timebase.now_us();
+    task->overruns = 0;
+    task->max_us = 0;
+
+    // Keep the run order sorted by priority, after any tasks of the same
+    //  priority, without moving the task itself so its index stays valid.
+    int pos = this->_n_tasks;
+    while ( (pos > 0) && (this->_tasks[this->_order[pos - 1]].priority > priority) ) {
+        this->_order[pos] = this->_order[pos - 1];
+        pos--;
+    }
+    this->_order[pos] = idx;
+
+    this->_n_tasks++;
+    return idx;
+}
+
+
+
+void
+Scheduler::_run_task(Task *task, uint64_t now) {
+
+    uint64_t start = timebase.read_cycles();
+    task->fn(task->context);
+    uint32_t duration = timebase.cycles_to_us(timebase.read_cycles() - start);
+    if (duration > task->max_us) {
+        task->max_us = duration;
+    }
+
+    if (task->period_us == 0) return;
+
+    // If we are a full period late, count it and resynchronise rather than
+    //  running the task several times back to back to catch up.
+    if (now >= task->next_us + task->period_us) {
+        task->overruns++;
+        task->next_us = now + task->period_us;
+    } else {
+        task->next_us += task->period_us;
+    }
+}
+
+
+
+void
+Scheduler::run() {
+
+    uint64_t now = timebase.now_us();
+    bool background_run = 0;
+
+    for (int i = 0; i < this->_n_tasks; i++) {
+
+        Task *task = &this->_tasks[this->_order[i]];
+        if ( (task->period_us != 0) && (now < task->next_us) ) continue;
+
+        // At most one background task per call.
+        if (task->priority > 0) {
+            if (background_run) continue;
+            background_run = 1;
+        }
+
+        this->_run_task(task, now);
+    }
+}
+
+
+
+int
+Scheduler::n_tasks() {
+
+    return this->_n_tasks;
+}
+
+
+
+uint32_t
+Scheduler::overruns(int task) {
+
+    return this->_tasks[task].overruns;
+}
+
+
+
+uint32_t
+Scheduler::max_us(int task) {
+
+    return this->_tasks[task].max_us;
+}
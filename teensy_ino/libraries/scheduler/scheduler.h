@@ -0,0 +1,77 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+//! Signature of a task run by the Scheduler.
+typedef void (*TaskFunction)(void *context);
+
+/*!
+    Small static cooperative scheduler.
+
+    Each task declares a period and a priority (0 is highest). On every call to run(), all due priority 0
+    tasks run, followed by at most one due task from the lower priorities (highest priority first), so that
+    slow housekeeping never stacks up in a single iteration and adds jitter to the priority 0 path.
+    Time is taken from the shared timebase, which must be updated before run().
+*/
+class Scheduler {
+
+    public:
+        //! Scheduler constructor
+        Scheduler();
+
+        /*! Add a task. Tasks run in order of priority, then in the order they were added.
+            \param fn Function to run.
+            \param context Pointer passed to fn.
+            \param period_us Period in microseconds, 0 to run on every call to run().
+            \param priority 0 runs every time it is due, higher values are background tasks.
+            \return Index of the task, or -1 if the table is full.
+        */
+        int add (TaskFunction fn, void *context, uint32_t period_us, uint8_t priority);
+
+        //! Run the tasks which are due.
+        void run ();
+
+        //! Number of tasks added.
+        int n_tasks ();
+
+        /*! Number of times a task was run a full period or more after it was due.
+            \param task Index returned by add().
+        */
+        uint32_t overruns (int task);
+
+        /*! Longest execution time of a task (microseconds).
+            \param task Index returned by add().
+        */
+        uint32_t max_us (int task);
+
+        //! Maximum number of tasks.
+        static const int max_tasks = 12;
+
+    private:
+        struct Task {
+            TaskFunction fn;
+            void *context;
+            uint32_t period_us;
+            uint8_t priority;
+            uint64_t next_us;
+            uint32_t overruns;
+            uint32_t max_us;
+        };
+
+        /*! Run a single task, update its overrun counter and next due time.
+            \param task Task to run.
+            \param now Timebase microseconds of this iteration.
+        */
+        void _run_task (Task *task, uint64_t now);
+
+        Task _tasks[max_tasks];
+
+        //! Indices into ::_tasks in the order they are run.
+        int _order[max_tasks];
+
+        int _n_tasks = 0;
+};
+
+
+#endif  /* SCHEDULER_H */
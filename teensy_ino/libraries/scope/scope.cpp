@@ -0,0 +1,130 @@
+#include <math.h>
+#include "Arduino.h"
+#include "scope.h"
+#include "options.h"
+
+
+
+Scope::Scope() {
+}
+
+
+
+void
+Scope::setup() {
+
+    this->arm(SCOPE_TRIGGERS, SCOPE_VELOCITY_MM_S);
+}
+
+
+
+void
+Scope::arm(uint8_t mask, float velocity_mm_s) {
+
+    this->_mask = mask;
+    this->_velocity_mm_s = velocity_mm_s;
+    this->_head = 0;
+    this->_count = 0;
+    this->_post_remaining = -1;
+    this->_previous_flags = 0;
+    this->frozen = 0;
+}
+
+
+
+void
+Scope::record(ScopeSample *sample) {
+
+    if (this->frozen) return;
+
+    if (fabsf(sample->velocity_mm_s) > this->_velocity_mm_s) {
+        sample->flags |= SCOPE_VELOCITY;
+    }
+
+    // A source already high when armed (or at boot) is not a rising edge.
+    if (this->_count == 0) {
+        this->_previous_flags = sample->flags;
+    }
+
+    int index = this->_head;
+    this->_dump.samples[index] = *sample;
+    this->_head = (this->_head + 1) % SCOPE_SAMPLES;
+    if (this->_count < SCOPE_SAMPLES) this->_count++;
+
+    // Count down the samples stored after the trigger, or trigger when an armed source goes high.
+    uint8_t rising = sample->flags & ~this->_previous_flags & this->_mask;
+    this->_previous_flags = sample->flags;
+    if (this->_post_remaining > 0) {
+        this->_post_remaining--;
+    } else if (rising && this->_post_remaining < 0) {
+        this->_trigger = index;
+        this->_source = rising;
+        this->_post_remaining = SCOPE_POST_SAMPLES;
+    }
+
+    // Freeze once the last post-trigger sample is stored.
+    if (this->_post_remaining == 0) {
+        this->_freeze(this->_source);
+    }
+}
+
+
+
+void
+Scope::_reverse(int first, int last) {
+
+    ScopeSample tmp;
+    last--;
+    while (first < last) {
+        tmp = this->_dump.samples[first];
+        this->_dump.samples[first] = this->_dump.samples[last];
+        this->_dump.samples[last] = tmp;
+        first++;
+        last--;
+    }
+}
+
+
+
+void
+Scope::_freeze(uint8_t source) {
+
+    // Until the buffer has wrapped, the oldest sample is already first.
+    int oldest = 0;
+    if (this->_count == SCOPE_SAMPLES) {
+        oldest = this->_head;
+        // Rotate in place so the oldest sample comes first.
+        this->_reverse(0, oldest);
+        this->_reverse(oldest, SCOPE_SAMPLES);
+        this->_reverse(0, SCOPE_SAMPLES);
+    }
+
+    ScopeHeader *h = &this->_dump.header;
+    h->n_samples = this->_count;
+    h->sample_bytes = sizeof(ScopeSample);
+    h->source = source;
+    h->reserved = 0;
+    h->sample_us = SCOPE_SAMPLE_US;
+    if (this->_post_remaining >= 0) {
+        h->trigger_index = (this->_trigger - oldest + SCOPE_SAMPLES) % SCOPE_SAMPLES;
+    } else {
+        h->trigger_index = (this->_count > 0) ? this->_count - 1 : 0;
+    }
+
+    this->frozen = 1;
+}
+
+
+
+const uint8_t *
+Scope::dump(uint16_t *length) {
+
+    if (!this->frozen) {
+        uint8_t source = SCOPE_MANUAL;
+        if (this->_post_remaining >= 0) source |= this->_source;
+        this->_freeze(source);
+    }
+
+    *length = sizeof(ScopeHeader) + this->_dump.header.n_samples * sizeof(ScopeSample);
+    return (const uint8_t *) &this->_dump;
+}
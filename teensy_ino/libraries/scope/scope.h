@@ -0,0 +1,139 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <stdint.h>
+#include "options.h"
+
+// Trigger sources, as bits of ScopeSample::flags and of the trigger mask
+#define SCOPE_TRIGGER_IN        0x01    // trigger input (ZERO_POSITION_PIN) is high
+#define SCOPE_REWARD            0x02    // trigger output (REWARD_PIN) is high
+#define SCOPE_DISABLE           0x04    // DISABLE_PIN is high
+#define SCOPE_VELOCITY          0x08    // encoder speed is above the velocity threshold
+#define SCOPE_MANUAL            0x80    // frozen by a dump request rather than a trigger
+
+
+/*!
+    One sample of the capture (24 bytes, little-endian).
+*/
+struct ScopeSample {
+    //! Low 32 bits of Timebase::now_us().
+    uint32_t time_us;
+
+    //! Encoder::edges, the number of accepted encoder edges.
+    uint32_t edges;
+
+    //! Encoder velocity (mm/s).
+    float velocity_mm_s;
+
+    //! Velocity being output, after filtering and gain (mm/s).
+    float output_mm_s;
+
+    //! Gain applied to the output.
+    float gain;
+
+    //! DAC code being output.
+    uint16_t dac_bits;
+
+    //! State of each trigger source (SCOPE_TRIGGER_IN ...).
+    uint8_t flags;
+
+    uint8_t reserved;
+};
+
+
+/*!
+    Header sent before the samples in reply to CMD_SCOPE_DUMP.
+*/
+struct ScopeHeader {
+    //! Number of samples which follow, oldest first.
+    uint16_t n_samples;
+
+    //! sizeof(ScopeSample).
+    uint16_t sample_bytes;
+
+    //! Index of the sample which triggered the capture.
+    uint16_t trigger_index;
+
+    //! Source which froze the capture (SCOPE_TRIGGER_IN ... or SCOPE_MANUAL).
+    uint8_t source;
+
+    uint8_t reserved;
+
+    //! Interval between samples (microseconds).
+    uint32_t sample_us;
+};
+
+
+/*!
+    Pre/post-trigger capture ("scope mode").
+
+    record() keeps the last ::SCOPE_SAMPLES samples in a circular buffer. When one of the armed trigger sources goes high,
+    ::SCOPE_POST_SAMPLES more are recorded and the buffer is frozen until arm() is called again.
+    dump() freezes the buffer if it is still running and returns the header followed by the samples, oldest first.
+*/
+class Scope {
+
+    public:
+        //! Scope constructor
+        Scope();
+
+        //! Arm with the trigger sources and velocity threshold from options.h.
+        void setup ();
+
+        /*! Clear the buffer and wait for a trigger.
+            \param mask Trigger sources to respond to (SCOPE_TRIGGER_IN | ...).
+            \param velocity_mm_s Speed above which SCOPE_VELOCITY is set.
+        */
+        void arm (uint8_t mask, float velocity_mm_s);
+
+        /*! Add a sample, unless frozen. Sets SCOPE_VELOCITY in its flags and checks for a trigger.
+            \param sample Sample to add.
+        */
+        void record (ScopeSample *sample);
+
+        /*! Freeze the buffer if it is running, and return the header and samples in order.
+            \param length Set to the size of the dump in bytes.
+        */
+        const uint8_t *dump (uint16_t *length);
+
+        //! Whether the buffer is frozen.
+        bool frozen = 0;
+
+    private:
+        //! Freeze the buffer and put the samples in order, oldest first.
+        void _freeze (uint8_t source);
+
+        /*! Reverse the samples between two indices.
+            \param first First sample.
+            \param last One past the last sample.
+        */
+        void _reverse (int first, int last);
+
+        //! Header and samples, contiguous so they can be sent as one reply.
+        struct {
+            ScopeHeader header;
+            ScopeSample samples[SCOPE_SAMPLES];
+        } _dump;
+
+        //! Index the next sample is written to.
+        int _head = 0;
+
+        //! Number of samples in the buffer.
+        int _count = 0;
+
+        //! Samples still to record after a trigger, or -1 while waiting for one.
+        int _post_remaining = -1;
+
+        //! Index of the sample which triggered the capture.
+        int _trigger = 0;
+        uint8_t _source = 0;
+
+        uint8_t _mask = 0;
+        float _velocity_mm_s = 0;
+
+        //! Flags of the previous sample, so that only rising trigger sources trigger. Seeded from the first sample.
+        uint8_t _previous_flags = 0;
+};
+
+
+#endif  /* SCOPE_H */
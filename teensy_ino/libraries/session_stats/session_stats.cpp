@@ -0,0 +1,96 @@
+#include <math.h>
+#include <string.h>
+#include "Arduino.h"
+#include "session_stats.h"
+#include "encoder.h"
+#include "timebase.h"
+#include "options.h"
+
+
+
+SessionStats::SessionStats() {
+}
+
+
+
+void
+SessionStats::setup() {
+
+    this->reset();
+}
+
+
+
+void
+SessionStats::reset() {
+
+    noInterrupts();
+    this->_forward_start = enc.forward_nm;
+    this->_backward_start = enc.backward_nm;
+    this->_reversals_start = enc.reversals;
+    interrupts();
+
+    this->_start_us = timebase.now_us();
+    this->_last_us = this->_start_us;
+
+    memset(&this->_summary, 0, sizeof(this->_summary));
+    this->_summary.bin_mm_s = STATS_BIN_MM_S;
+    this->_summary.n_bins = STATS_BINS;
+
+    this->_moving_remainder_us = 0;
+    for (int i = 0; i < STATS_BINS; i++) {
+        this->_bin_remainder_us[i] = 0;
+    }
+}
+
+
+
+void
+SessionStats::loop() {
+
+    uint64_t now = timebase.now_us();
+    uint32_t dt = (uint32_t) (now - this->_last_us);
+    this->_last_us = now;
+
+    float speed = fabsf(enc.current_velocity);
+
+    if (speed > this->_summary.peak_mm_s) {
+        this->_summary.peak_mm_s = speed;
+    }
+
+    // Time is kept in us until a whole ms has built up, so that short periods are not lost.
+    if (speed > this->_moving_mm_s) {
+        this->_moving_remainder_us += dt;
+        this->_summary.moving_ms += this->_moving_remainder_us / 1000;
+        this->_moving_remainder_us %= 1000;
+    }
+
+    int bin = (int) (speed / this->_bin_mm_s);
+    if (bin >= STATS_BINS) bin = STATS_BINS - 1;
+    this->_bin_remainder_us[bin] += dt;
+    this->_summary.histogram_ms[bin] += this->_bin_remainder_us[bin] / 1000;
+    this->_bin_remainder_us[bin] %= 1000;
+}
+
+
+
+const uint8_t *
+SessionStats::summary(uint16_t *length) {
+
+    // A copy, as loop() keeps updating ::_summary while the reply is sent.
+    this->_snapshot = this->_summary;
+
+    noInterrupts();
+    uint64_t forward_nm = enc.forward_nm - this->_forward_start;
+    uint64_t backward_nm = enc.backward_nm - this->_backward_start;
+    this->_snapshot.reversals = enc.reversals - this->_reversals_start;
+    interrupts();
+
+    this->_snapshot.forward_mm = (float) (forward_nm * 1e-6);
+    this->_snapshot.backward_mm = (float) (backward_nm * 1e-6);
+
+    this->_snapshot.duration_ms = (uint32_t) ((timebase.now_us() - this->_start_us) / 1000);
+
+    *length = sizeof(this->_snapshot);
+    return (const uint8_t *) &this->_snapshot;
+}
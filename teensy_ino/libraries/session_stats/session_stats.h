@@ -0,0 +1,88 @@
+#ifndef SESSION_STATS_H
+#define SESSION_STATS_H
+
+#include <stdint.h>
+#include "options.h"
+
+
+/*!
+    Summary of a window, sent to the host as the reply to CMD_GET_STATS (little-endian, 4-byte fields).
+*/
+struct SessionSummary {
+    //! Length of the window so far (ms).
+    uint32_t duration_ms;
+
+    //! Time spent faster than STATS_MOVING_MM_S (ms).
+    uint32_t moving_ms;
+
+    //! Distance travelled forwards and backwards (mm, both positive).
+    float forward_mm;
+    float backward_mm;
+
+    //! Highest speed in either direction (mm/s).
+    float peak_mm_s;
+
+    //! Number of changes of direction.
+    uint32_t reversals;
+
+    //! Width of each histogram bin (mm/s) and number of bins.
+    uint16_t bin_mm_s;
+    uint16_t n_bins;
+
+    //! Time spent at each speed (ms). Bin i covers i * bin_mm_s up to (i + 1) * bin_mm_s, the last bin everything above.
+    uint32_t histogram_ms[STATS_BINS];
+};
+
+
+/*!
+    Running statistics of the treadmill over a window, e.g. a trial, in constant memory.
+
+    Distance and reversals are taken from the encoder's totals, so they count every edge. Moving time, peak speed
+    and the speed histogram are weighted by the time between calls to loop(). reset() starts a new window.
+*/
+class SessionStats {
+
+    public:
+        //! SessionStats constructor
+        SessionStats();
+
+        //! Start the first window.
+        void setup ();
+
+        //! Start a new window.
+        void reset ();
+
+        //! Main loop method. Adds the time since the last call at the current encoder speed.
+        void loop ();
+
+        /*! Return a snapshot of the summary of the current window, unchanged until the next call.
+            \param length Set to the size of the summary in bytes.
+        */
+        const uint8_t *summary (uint16_t *length);
+
+    private:
+        //! Summary being accumulated. Distances and reversals are filled in by summary().
+        SessionSummary _summary;
+
+        //! Copy of ::_summary returned by summary().
+        SessionSummary _snapshot;
+
+        //! Encoder totals at the start of the window.
+        uint64_t _forward_start = 0;
+        uint64_t _backward_start = 0;
+        uint32_t _reversals_start = 0;
+
+        //! Timebase::now_us() at the start of the window and the last loop().
+        uint64_t _start_us = 0;
+        uint64_t _last_us = 0;
+
+        //! Time not yet added to ::_summary, to keep whole ms without drift (us).
+        uint32_t _moving_remainder_us = 0;
+        uint32_t _bin_remainder_us[STATS_BINS];
+
+        const float _moving_mm_s = STATS_MOVING_MM_S;
+        const float _bin_mm_s = STATS_BIN_MM_S;
+};
+
+
+#endif  /* SESSION_STATS_H */
@@ -0,0 +1,89 @@
+#include "Arduino.h"
+#include "sync_pulse.h"
+#include "timebase.h"
+#include "options.h"
+
+IntervalTimer sync_timer;
+SyncPulse *SyncPulse::_active = 0;
+
+
+
+SyncPulse::SyncPulse() {
+}
+
+
+
+void
+SyncPulse::_encode() {
+
+    uint16_t n = 0;
+    uint32_t code = this->frames;
+
+    for (int i = 0; i < SYNC_MARKER_TICKS; i++) this->_levels[n++] = HIGH;
+    for (int i = 0; i < SYNC_GAP_TICKS; i++) this->_levels[n++] = LOW;
+
+    for (int b = 0; b < SYNC_BITS; b++) {
+        int high_ticks = ((code >> b) & 1) ? SYNC_ONE_TICKS : SYNC_ZERO_TICKS;
+        for (int i = 0; i < high_ticks; i++) this->_levels[n++] = HIGH;
+        for (int i = 0; i < SYNC_GAP_TICKS; i++) this->_levels[n++] = LOW;
+    }
+
+    this->_n_levels = n;
+}
+
+
+
+void
+SyncPulse::_tick() {
+
+    SyncPulse *sp = SyncPulse::_active;
+
+    // The level is written first so that edges keep the timer's timing.
+    if (sp->_tick_n < sp->_n_levels) {
+        digitalWriteFast(SYNC_PIN, sp->_levels[sp->_tick_n]);
+    }
+
+    sp->_tick_n++;
+
+    // Encode the next frame once the current one has been written out, well before it is due.
+    if (sp->_tick_n == sp->_n_levels) {
+        sp->frames++;
+        sp->_encode();
+    }
+
+    if (sp->_tick_n >= sp->_ticks_per_period) {
+        sp->_tick_n = 0;
+    }
+}
+
+
+
+void
+SyncPulse::setup() {
+
+    pinMode(SYNC_PIN, OUTPUT);
+    digitalWriteFast(SYNC_PIN, LOW);
+
+    this->frames = 0;
+    this->_tick_n = 0;
+    this->_encode();
+    SyncPulse::_active = this;
+
+    // The first interrupt, which starts frame 0, is one tick after begin().
+    noInterrupts();
+    this->start_us = timebase.read_cycles() / timebase.cycles_per_us + SYNC_TICK_US;
+    sync_timer.begin(SyncPulse::_tick, SYNC_TICK_US);
+    interrupts();
+}
+
+
+
+uint64_t
+SyncPulse::frame_us(uint32_t frame) {
+
+    return this->start_us + (uint64_t) frame * SYNC_PERIOD_US;
+}
+
+
+
+SyncPulse sync_pulse = SyncPulse();
@@ -0,0 +1,69 @@
+#ifndef SYNC_PULSE_H
+#define SYNC_PULSE_H
+
+#include <stdint.h>
+#include "options.h"
+
+// Pulse widths, in ticks of SYNC_TICK_US
+#define SYNC_MARKER_TICKS       4       // high time of the pulse starting each frame
+#define SYNC_ZERO_TICKS         1       // high time of a 0 bit
+#define SYNC_ONE_TICKS          2       // high time of a 1 bit
+#define SYNC_GAP_TICKS          1       // low time after every pulse
+
+//! Longest frame, in ticks.
+#define SYNC_FRAME_TICKS        (SYNC_MARKER_TICKS + SYNC_GAP_TICKS + SYNC_BITS * (SYNC_ONE_TICKS + SYNC_GAP_TICKS))
+
+
+/*!
+    Coded sync pulses for aligning Teensy time with an external acquisition.
+
+    Every ::SYNC_PERIOD_US a frame is written on ::SYNC_PIN: a marker pulse followed by the frame number (::SYNC_BITS bits, least
+    significant first), with each bit encoded as the width of one pulse. Pins are switched from a hardware timer interrupt which
+    runs from the same crystal as the cycle counter, so the rising edge of the marker of frame k is at frame_us(k) in Teensy time.
+    The `sync_fit` tool recovers the frames from an NI recording and fits the mapping from Teensy time to NI samples.
+*/
+class SyncPulse {
+
+    public:
+        //! SyncPulse constructor
+        SyncPulse();
+
+        //! Setup the pin and start the timer. Frame 0 starts one tick later.
+        void setup ();
+
+        /*! Teensy time (as Timebase::now_us()) of the marker rising edge of a frame.
+            \param frame Frame number, counting from 0 without wrapping.
+        */
+        uint64_t frame_us (uint32_t frame);
+
+        //! Teensy time (as Timebase::now_us()) of the marker rising edge of frame 0.
+        uint64_t start_us = 0;
+
+        //! Number of the frame being written, or next to be written.
+        volatile uint32_t frames = 0;
+
+    private:
+        //! Timer interrupt. Writes the next level of the frame.
+        static void _tick ();
+
+        //! Fill ::_levels with the pulse train for the frame number ::frames.
+        void _encode ();
+
+        //! Pin level on each tick of the current frame.
+        uint8_t _levels[SYNC_FRAME_TICKS];
+
+        //! Ticks in the current frame which have a level in ::_levels.
+        uint16_t _n_levels = 0;
+
+        //! Tick within the current period.
+        uint32_t _tick_n = 0;
+
+        const uint32_t _ticks_per_period = SYNC_PERIOD_US / SYNC_TICK_US;
+
+        //! Instance serviced by the timer interrupt.
+        static SyncPulse *_active;
+};
+
+extern SyncPulse sync_pulse;
+
+#endif  /* SYNC_PULSE_H */
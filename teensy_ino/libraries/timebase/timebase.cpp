@@ -0,0 +1,94 @@
+#include "Arduino.h"
+#include "timebase.h"
+
+
+
+Timebase::Timebase() {
+}
+
+
+
+void
+Timebase::setup() {
+
+    // The cycle counter is part of the debug unit and must be switched on.
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+
+    this->_high = 0;
+    this->_last_low = ARM_DWT_CYCCNT;
+    this->update();
+}
+
+
+
+void
+Timebase::update() {
+
+    // Interrupts read _high and _last_low, so update them together.
+    noInterrupts();
+    uint32_t low = ARM_DWT_CYCCNT;
+    if (low < this->_last_low) {
+        this->_high++;
+    }
+    this->_last_low = low;
+    this->_cycles = ((uint64_t) this->_high << 32) | low;
+    interrupts();
+
+    this->_us = this->_cycles / this->cycles_per_us;
+}
+
+
+
+uint64_t
+Timebase::cycles() {
+
+    return this->_cycles;
+}
+
+
+
+uint64_t
+Timebase::now_us() {
+
+    return this->_us;
+}
+
+
+
+uint64_t
+Timebase::now_ms() {
+
+    return this->_us / 1000;
+}
+
+
+
+FASTRUN uint64_t
+Timebase::read_cycles() {
+
+    // If the counter is below its value at the last update() it has wrapped since.
+    uint32_t low = ARM_DWT_CYCCNT;
+    uint32_t high = this->_high;
+    if (low < this->_last_low) {
+        high++;
+    }
+    return ((uint64_t) high << 32) | low;
+}
+
+
+
+FASTRUN uint32_t
+Timebase::cycles_to_us(uint64_t delta_cycles) {
+
+    // Most intervals fit in 32 bits, which divides in hardware.
+    if (delta_cycles <= UINT32_MAX) {
+        return (uint32_t) delta_cycles / this->cycles_per_us;
+    }
+    if (delta_cycles >= (uint64_t) UINT32_MAX * this->cycles_per_us) {
+        return UINT32_MAX;
+    }
+    return (uint32_t) (delta_cycles / this->cycles_per_us);
+}
+
+Timebase timebase = Timebase();
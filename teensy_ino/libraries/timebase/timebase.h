@@ -0,0 +1,59 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+
+/*!
+    Monotonic 64-bit timebase shared by all modules.
+
+    Extends the 32-bit CPU cycle counter (which wraps every 2^32 / F_CPU seconds, ~45 s at 96 MHz) to 64 bits.
+    update() samples the counter once per loop iteration and modules read that sample with cycles(), now_us() and now_ms(),
+    so that everything in one iteration sees the same time. Interrupt handlers use read_cycles() for a live timestamp.
+    update() must be called at least once per wrap of the cycle counter.
+*/
+class Timebase {
+
+    public:
+        //! Timebase constructor
+        Timebase();
+
+        //! Enable the cycle counter and take the first sample.
+        void setup ();
+
+        //! Sample the cycle counter. Call once at the start of each loop iteration.
+        void update ();
+
+        //! Cycle count at the last update().
+        uint64_t cycles ();
+
+        //! Microseconds at the last update().
+        uint64_t now_us ();
+
+        //! Milliseconds at the last update().
+        uint64_t now_ms ();
+
+        //! Live 64-bit cycle count. Safe to call from interrupts.
+        uint64_t read_cycles ();
+
+        /*! Convert a cycle interval to microseconds, saturating at UINT32_MAX.
+            \param delta_cycles Cycle interval.
+        */
+        uint32_t cycles_to_us (uint64_t delta_cycles);
+
+        //! CPU cycles per microsecond.
+        const uint32_t cycles_per_us = F_CPU / 1000000;
+
+    private:
+        //! Upper 32 bits of the extended count at the last update().
+        volatile uint32_t _high = 0;
+
+        //! Cycle counter at the last update().
+        volatile uint32_t _last_low = 0;
+
+        uint64_t _cycles = 0;
+        uint64_t _us = 0;
+};
+
+extern Timebase timebase;
+
+#endif  /* TIMEBASE_H */
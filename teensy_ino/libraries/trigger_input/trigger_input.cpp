@@ -1,5 +1,6 @@
 #include "Arduino.h"
 #include "trigger_input.h"
+#include "gpio_snapshot.h"
 #include "options.h"
 
 
@@ -11,7 +12,8 @@ TriggerInput::TriggerInput() {
 void
 TriggerInput::_get_state() {
 
-    this->current_state = digitalRead(this->_pin);
+    // Level from this iteration's snapshot, consistent with every other input.
+    this->current_state = gpio.read(this->_pin);
 
     this->delta_state = 0;
     if (this->current_state == HIGH && this->_previous_state == LOW) {
@@ -29,8 +31,9 @@ TriggerInput::setup(int pin) {
 
     this->_pin = pin;
     pinMode(this->_pin, INPUT);
+    gpio.watch(this->_pin);
 
-    this->current_state = digitalRead(this->_pin);
+    this->current_state = gpio.read(this->_pin);
     this->_previous_state = this->current_state;
     this->delta_state = 0;
 }
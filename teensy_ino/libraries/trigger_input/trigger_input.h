@@ -26,7 +26,7 @@ class TriggerInput {
         
     private:
         
-        //! Reads the current pin state and updates ::current_state, ::delta_state, ::_previous_state.
+        //! Reads the current pin state from the GpioSnapshot and updates ::current_state, ::delta_state, ::_previous_state.
         void _get_state();
         
         //! Pin to listen for trigger on.
@@ -1,5 +1,6 @@
 #include "Arduino.h"
 #include "trigger_output.h"
+#include "timebase.h"
 #include "options.h"
 
 
@@ -21,7 +22,14 @@ TriggerOutput::start() {
 
     digitalWrite(this->_pin, HIGH);
     this->_on = 1;
-    this->_time_started = millis();
+    this->_time_started = timebase.now_ms();
+}
+
+
+bool
+TriggerOutput::on() {
+
+    return this->_on;
 }
 
 
@@ -37,7 +45,7 @@ void
 TriggerOutput::loop() {
     
     if (this->_on) {    
-        if ((millis() - this->_time_started) >= this->_duration) {
+        if ((timebase.now_ms() - this->_time_started) >= this->_duration) {
             this->_stop();
         }
     }
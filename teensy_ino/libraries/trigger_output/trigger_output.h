@@ -1,6 +1,8 @@
 #ifndef TRIGGER_OUTPUT_H
 #define TRIGGER_OUTPUT_H
 
+#include <stdint.h>
+
 /*!
     Deals with writing on pins used as trigger outputs.
 */
@@ -20,6 +22,9 @@ class TriggerOutput {
 
 		//! Initiates a trigger output event by writing a digital output on ::_pin and updating the ::_time_started of the trigger event.
         void start();
+
+		//! Whether a trigger output event is in progress.
+        bool on();
         
         
 	private:
@@ -30,10 +35,10 @@ class TriggerOutput {
 		bool _on = 0;
 
 		//! Duration of trigger output event in ms.
-		unsigned int _duration = 50;
+		uint32_t _duration = 50;
 
 		//! The time that the last trigger output event was initiated in ms.
-		int _time_started;
+		uint64_t _time_started;
 
 		//! The pin to write trigger output events to.
 		int _pin;
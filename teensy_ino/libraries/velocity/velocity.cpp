@@ -1,6 +1,7 @@
 #include <math.h>
 #include "Arduino.h"
 #include "velocity.h"
+#include "timebase.h"
 
 
 
@@ -60,8 +61,8 @@ Velocity::_average(float enc_velocity) {
 void
 Velocity::_filter(float enc_velocity) {
     
-    // get the current time
-    this->_this_micros = micros();
+    // get the time sampled for this loop iteration
+    this->_this_micros = timebase.now_us();
     
     // every _new_update_us microseconds
     if ( this->_this_micros > this->_last_micros + this->_new_update_us ) {
@@ -75,11 +76,6 @@ Velocity::_filter(float enc_velocity) {
         // perform the averaging of the velocity
         this->_new_velocity = this->_average(enc_velocity);
     }
-    
-    // if micros this time is smaller than the previous time, we've overflowed...
-    if ( this->_this_micros < this -> _last_micros ) {
-        this->_last_micros = 0;
-    }
 }
 
 
@@ -1,6 +1,7 @@
 #ifndef VELOCITY_H
 #define VELOCITY_H
 
+#include <stdint.h>
 #include "options.h"
 
 /*!
@@ -60,8 +61,9 @@ class Velocity {
 
         int _current_idx = 0;
 
-        unsigned long _this_micros;
-        unsigned long _last_micros;
+        //! Timebase microseconds of this loop and of the last filter update.
+        uint64_t _this_micros = 0;
+        uint64_t _last_micros = 0;
 
         //! Whether to decrease the filtering window with faster speeds.
         const bool _variable_window = VARIABLE_WINDOW;
@@ -0,0 +1,194 @@
+#include "Arduino.h"
+#include "waveform_out.h"
+#include "options.h"
+
+
+// PDB triggered by software, continuous, requesting a DMA transfer each period.
+#define PDB_CONFIG (PDB_SC_TRGSEL(15) | PDB_SC_PDBEN | PDB_SC_CONT | PDB_SC_PDBIE | PDB_SC_DMAEN)
+
+
+
+WaveformOut::WaveformOut() {
+}
+
+
+
+uint16_t
+WaveformOut::_volts_to_bits(float volts) {
+
+    float temp = volts * (float) this->_max_dac_bits / this->_max_dac_volts;
+    if ( temp < 0 ) temp = 0;
+    if ( temp > this->_max_dac_bits ) temp = this->_max_dac_bits;
+    return (uint16_t) temp;
+}
+
+
+
+void
+WaveformOut::_hold(int half, uint16_t bits) {
+
+    uint16_t *p = this->_buffer + half * this->_half_samples;
+    for (int i = 0; i < this->_half_samples; i++) {
+        p[i] = bits;
+    }
+}
+
+
+
+void
+WaveformOut::_isr() {
+
+    // The source address tells us which half the DMA is now reading.
+    uint32_t saddr = (uint32_t) wave._dma.TCD->SADDR;
+    wave._dma.clearInterrupt();
+
+    int finished = ( saddr < (uint32_t) (wave._buffer + wave._half_samples) ) ? 1 : 0;
+    int playing = 1 - finished;
+
+    // The half now playing was never refilled.
+    if ( !wave._ready[playing] ) {
+        wave.underruns++;
+    }
+
+    // Hold the last sample played in the finished half, so that if the host
+    //  does not refill it in time we hold rather than replay stale data.
+    uint16_t last = wave._buffer[finished * wave._half_samples + wave._half_samples - 1];
+    wave._hold(finished, last);
+    wave._ready[finished] = 0;
+    wave._pending = finished;
+    wave._handoffs++;
+}
+
+
+
+void
+WaveformOut::setup(float dac_offset_volts) {
+
+    // analogWrite powers up the DAC with the 3.3V reference.
+    analogWriteResolution(12);
+    this->_offset_bits = this->_volts_to_bits(dac_offset_volts);
+    analogWrite(DAC_PIN, this->_offset_bits);
+
+    this->_hold(0, this->_offset_bits);
+    this->_hold(1, this->_offset_bits);
+
+    // Circular 16-bit transfer from the buffer to the DAC data register.
+    this->_dma.begin(true);
+    this->_dma.TCD->SADDR = this->_buffer;
+    this->_dma.TCD->SOFF = 2;
+    this->_dma.TCD->ATTR = DMA_TCD_ATTR_SSIZE(1) | DMA_TCD_ATTR_DSIZE(1);
+    this->_dma.TCD->NBYTES_MLNO = 2;
+    this->_dma.TCD->SLAST = -sizeof(this->_buffer);
+    this->_dma.TCD->DADDR = &DAC0_DAT0L;
+    this->_dma.TCD->DOFF = 0;
+    this->_dma.TCD->CITER_ELINKNO = sizeof(this->_buffer) / 2;
+    this->_dma.TCD->DLASTSGA = 0;
+    this->_dma.TCD->BITER_ELINKNO = sizeof(this->_buffer) / 2;
+    this->_dma.TCD->CSR = DMA_TCD_CSR_INTHALF | DMA_TCD_CSR_INTMAJOR;
+    this->_dma.triggerAtHardwareEvent(DMAMUX_SOURCE_PDB);
+    this->_dma.attachInterrupt(this->_isr);
+
+    SIM_SCGC6 |= SIM_SCGC6_PDB;
+}
+
+
+
+void
+WaveformOut::start() {
+
+    if (this->running) return;
+
+    // Both halves must be filled before the timer is started (see loop()).
+    this->_hold(0, this->_offset_bits);
+    this->_hold(1, this->_offset_bits);
+    this->_ready[0] = 0;
+    this->_ready[1] = 0;
+    this->_pending = 0;
+    this->_handoffs++;
+    this->_priming = 1;
+    this->underruns = 0;
+
+    // A stop() part way through the buffer leaves both the address and the
+    // count there, so restart the major loop from the beginning.
+    this->_dma.TCD->SADDR = this->_buffer;
+    this->_dma.TCD->CITER_ELINKNO = this->_dma.TCD->BITER_ELINKNO;
+    this->_dma.enable();
+
+    this->running = 1;
+}
+
+
+
+void
+WaveformOut::_start_timer() {
+
+    PDB0_IDLY = 1;
+    PDB0_MOD = F_BUS / this->_rate_hz - 1;
+    PDB0_SC = PDB_CONFIG | PDB_SC_LDOK;
+    PDB0_SC = PDB_CONFIG | PDB_SC_SWTRIG;
+}
+
+
+
+void
+WaveformOut::stop() {
+
+    PDB0_SC = 0;
+    this->_dma.disable();
+    analogWrite(DAC_PIN, this->_offset_bits);
+    this->running = 0;
+}
+
+
+
+void
+WaveformOut::loop() {
+
+    if (!this->running) return;
+
+    noInterrupts();
+    int half = this->_pending;
+    uint32_t handoff = this->_handoffs;
+    interrupts();
+
+    if (half < 0) return;
+
+    // A new half has been handed to us, start filling it from the beginning.
+    if (handoff != this->_filling) {
+        this->_filling = handoff;
+        this->_received = 0;
+    }
+
+    // Copy as many whole samples as have arrived into the pending half. Stop
+    //  if the DMA moves on and the interrupt hands us the other half.
+    uint16_t *p = this->_buffer + half * this->_half_samples;
+    while ( (this->_received < this->_half_samples) && (Serial.available() >= 2) && (this->_handoffs == handoff) ) {
+        uint8_t lo = Serial.read();
+        uint8_t hi = Serial.read();
+        uint16_t bits = (uint16_t) (lo | (hi << 8));
+        if ( bits > this->_max_dac_bits ) bits = this->_max_dac_bits;
+        p[this->_received++] = bits;
+    }
+
+    // Only hand the half back once it is full.
+    noInterrupts();
+    if ( (this->_handoffs == handoff) && (this->_received == this->_half_samples) ) {
+        this->_ready[half] = 1;
+        this->_pending = -1;
+
+        // While priming, fill the second half straight after the first.
+        if (this->_priming && half == 0) {
+            this->_pending = 1;
+            this->_handoffs++;
+        }
+    }
+    interrupts();
+
+    // Start clocking once both halves are full.
+    if ( this->_priming && this->_ready[0] && this->_ready[1] ) {
+        this->_priming = 0;
+        this->_start_timer();
+    }
+}
+
+WaveformOut wave = WaveformOut();
@@ -0,0 +1,94 @@
+#ifndef WAVEFORM_OUT_H
+#define WAVEFORM_OUT_H
+
+#include <DMAChannel.h>
+#include "options.h"
+
+/*!
+    Clocks a waveform out of the DAC at a fixed rate using the PDB timer and DMA.
+
+    The buffer is split into two halves. While the DMA plays one half, the other is
+    refilled in loop() with raw 12-bit DAC codes (little-endian uint16) streamed over USB serial.
+    If the host does not keep up, the last sample written is held.
+*/
+class WaveformOut {
+
+    public:
+        //! WaveformOut constructor
+        WaveformOut();
+
+        /*! Setup the DAC and DMA channel and write the offset voltage to the output.
+            \param dac_offset_volts Offset value to write in volts, also written on stop().
+        */
+        void setup (float dac_offset_volts);
+
+        //! Start streaming. The buffer is clocked out to the DAC at ::_rate_hz once both halves have been filled.
+        void start ();
+
+        //! Stop the timer and DMA and return the output to the offset voltage.
+        void stop ();
+
+        //! Main loop method. Refills any half of the buffer the DMA has finished with.
+        void loop ();
+
+        //! Whether the waveform is currently being clocked out.
+        bool running = 0;
+
+        //! Number of half buffers which started playing before they had been refilled.
+        volatile uint32_t underruns = 0;
+
+    private:
+        //! Attached to the DMA half and major loop interrupts. Marks the finished half for refill.
+        static void _isr ();
+
+        //! Start the PDB timer which requests one DMA transfer every sample period.
+        void _start_timer ();
+
+        /*! Fill one half of the buffer with a single DAC code.
+            \param half 0 or 1
+            \param bits DAC code
+        */
+        void _hold (int half, uint16_t bits);
+
+        //! Converts a voltage value to a DAC code.
+        uint16_t _volts_to_bits (float volts);
+
+        //! Output sample rate (Hz).
+        const uint32_t _rate_hz = WAVEFORM_RATE_HZ;
+
+        //! Number of samples in each half of the buffer.
+        static const int _half_samples = WAVEFORM_HALF_SAMPLES;
+
+        //! Both halves of the buffer, played circularly by the DMA.
+        uint16_t _buffer[2 * _half_samples] __attribute__ ((aligned (16)));
+
+        //! Whether each half has been refilled since it was last played.
+        volatile bool _ready[2] = {0, 0};
+
+        //! Half which the DMA has finished with and is waiting for data, -1 if none.
+        volatile int _pending = -1;
+
+        //! Whether we are filling both halves before starting the timer.
+        bool _priming = 0;
+
+        //! Incremented each time a half is handed over for refilling.
+        volatile uint32_t _handoffs = 0;
+
+        //! Value of ::_handoffs for the half currently being filled.
+        uint32_t _filling = 0;
+
+        //! Number of samples already received into the half being filled.
+        int _received = 0;
+
+        //! DAC code of the offset voltage.
+        uint16_t _offset_bits;
+
+        DMAChannel _dma;
+
+        const float _max_dac_volts = MAX_DAC_VOLTS;
+        const uint16_t _max_dac_bits = MAX_DAC_BITS;
+};
+
+extern WaveformOut wave;
+
+#endif  /* WAVEFORM_OUT_H */
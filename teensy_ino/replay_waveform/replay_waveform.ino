@@ -0,0 +1,49 @@
+/* REPLAY_WAVEFORM.INO
+ * 
+ * script for 
+ * 1. wait for trigger input
+ * 2. clock a waveform streamed over USB out of the DAC at a fixed rate
+ *
+ * The host streams raw 12-bit DAC codes as little-endian uint16 values.
+ * Playback starts once two half buffers have been received and stops when
+ * the trigger input goes low again.
+ */
+
+
+#include "options.h"
+#include "waveform_out.h"
+#include "trigger_input.h"
+#include "gpio_snapshot.h"
+
+#define DAC_OFFSET 		0.5
+
+
+TriggerInput trig_in = TriggerInput();
+
+
+void
+setup() {
+    
+    Serial.begin(9600);
+    wave.setup(DAC_OFFSET);
+    trig_in.setup(ZERO_POSITION_PIN);
+}
+
+
+void
+loop() {
+	
+	// Check state of the trigger input
+    gpio.capture();
+    trig_in.loop();
+    
+    // Start on the rising edge, stop on the falling edge.
+    if (trig_in.delta_state == 1) {
+        wave.start();
+    } else if (trig_in.delta_state == -1) {
+        wave.stop();
+    }
+    
+    // Refill the buffer from USB.
+    wave.loop();
+}
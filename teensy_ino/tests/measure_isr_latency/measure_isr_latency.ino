@@ -0,0 +1,86 @@
+/* measure_isr_latency.ino
+   Measures the entry latency of the encoder interrupt while USB serial and a timer interrupt are busy.
+   Wire TEST_PIN to ENC_A_PIN.
+*/
+
+#include "options.h"
+#include "timebase.h"
+#include "encoder.h"
+
+const int TEST_PIN = 2;
+
+// Competing timer interrupt, e.g. DAC noise shaping.
+const int LOAD_TIMER_US = 20;
+IntervalTimer load_timer;
+volatile uint32_t load_ticks = 0;
+
+// Latency statistics (cycles), reported every REPORT_MS.
+const int REPORT_MS = 1000;
+uint32_t n_edges = 0;
+uint32_t n_missed = 0;
+uint32_t min_latency = UINT32_MAX;
+uint32_t max_latency = 0;
+uint64_t sum_latency = 0;
+uint32_t last_report = 0;
+
+char padding[256];
+
+
+void load_isr() {
+  load_ticks++;
+}
+
+
+void setup() {
+
+  Serial.begin(9600);
+  timebase.setup();
+  enc.setup(FORWARD_AND_BACKWARD);
+
+  pinMode(TEST_PIN, OUTPUT);
+  digitalWriteFast(TEST_PIN, LOW);
+
+  load_timer.begin(load_isr, LOAD_TIMER_US);
+
+  for (unsigned int i = 0; i < sizeof(padding) - 1; i++) padding[i] = 'x';
+  padding[sizeof(padding) - 1] = '\n';
+}
+
+
+void loop() {
+
+  timebase.update();
+
+  // Raise the pin and wait for the interrupt to record its entry time.
+  uint32_t count = enc.isr_count;
+  uint32_t start = ARM_DWT_CYCCNT;
+  digitalWriteFast(TEST_PIN, HIGH);
+  while (enc.isr_count == count && (ARM_DWT_CYCCNT - start) < 96000) ;
+
+  if (enc.isr_count != count) {
+    uint32_t latency = enc.isr_entry_cycles - start;
+    n_edges++;
+    sum_latency += latency;
+    if (latency < min_latency) min_latency = latency;
+    if (latency > max_latency) max_latency = latency;
+  } else {
+    n_missed++;
+  }
+
+  digitalWriteFast(TEST_PIN, LOW);
+
+  // Keep the USB busy between edges.
+  Serial.write(padding, sizeof(padding));
+
+  if (millis() - last_report >= REPORT_MS) {
+    last_report = millis();
+    Serial.printf("fast_isr %d edges %lu missed %lu latency_cycles min %lu mean %lu max %lu max_ns %lu isr_max_cycles %lu\n",
+                  enc.fast_isr_active, n_edges, n_missed, min_latency, (uint32_t) (n_edges ? sum_latency / n_edges : 0),
+                  max_latency, (uint32_t) ((uint64_t) max_latency * 1000 / timebase.cycles_per_us), enc.isr_max_cycles);
+    n_edges = 0;
+    n_missed = 0;
+    min_latency = UINT32_MAX;
+    max_latency = 0;
+    sum_latency = 0;
+  }
+}